@@ -0,0 +1,432 @@
+/*
+ * eddsa-bench - measures the public functions and the internal
+ * primitives of the library.
+ *
+ * every benchmark takes a number of samples, each timing a run of calls,
+ * and reports the median and the quartiles of the cost of a single call.
+ * the functions hashing a message are run for a sweep of message sizes.
+ *
+ * the cost is given in cycles of the time stamp counter on x86 and in
+ * nanoseconds elsewhere. the output is json and names the bitness, the
+ * active simd code paths and the stack cleaning of the build, so results
+ * of different builds can be put side by side.
+ *
+ * usage: eddsa-bench [-s samples] [name ...]
+ *
+ * with names given, only the benchmarks starting with one of them run.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <eddsa.h>
+
+#include "fld.h"
+#include "sc.h"
+#include "ed.h"
+#include "sha512.h"
+#include "cpu.h"
+
+
+#define SAMPLES		101
+#define MAX_LEN		16384
+
+/* flags of the benchmarks */
+#define SWEEP		1	/* run for all message sizes */
+#define PER_BYTE	2	/* report the cost per byte as well */
+
+
+/*
+ * ticks - the current time in cycles or nanoseconds, see TIMER_UNIT
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define TIMER_UNIT	"cycles"
+
+static INLINE uint64_t
+ticks(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+
+	return ((uint64_t)hi << 32) | lo;
+}
+
+#else
+
+#define TIMER_UNIT	"ns"
+
+static INLINE uint64_t
+ticks(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#endif
+
+
+/*
+ * the data the benchmarks work on
+ */
+static uint8_t sec[ED25519_KEY_LEN], pub[ED25519_KEY_LEN];
+static uint8_t sig[ED25519_SIG_LEN];
+static uint8_t point[X25519_KEY_LEN], out[X25519_KEY_LEN];
+static uint8_t msg[MAX_LEN];
+
+static fld_t fa, fb;
+static sc_t sa, sb;
+static lsc_t lx;
+static struct ed P, R;
+
+
+/*
+ * the benchmarks, each does n calls of its function
+ */
+static void
+b_fld_mul(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		fld_mul(fa, fa, fb);
+}
+
+static void
+b_fld_sq(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		fld_sq(fa, fa);
+}
+
+static void
+b_fld_inv(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		fld_inv(fa, fa);
+}
+
+static void
+b_sc_mul(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		sc_mul(sa, sa, sb);
+}
+
+static void
+b_sc_barrett(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		sc_barrett(sa, lx);
+}
+
+static void
+b_ed_scale_base(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		ed_scale_base(&R, sa);
+}
+
+static void
+b_ed_dual_scale(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		ed_dual_scale(&R, sa, sb, &P);
+}
+
+static void
+b_sha512(int n, size_t len)
+{
+	struct sha512 ctx;
+	uint8_t h[SHA512_HASH_LENGTH];
+
+	while (n--) {
+		sha512_init(&ctx);
+		sha512_add(&ctx, msg, len);
+		sha512_final(&ctx, h);
+	}
+}
+
+static void
+b_genpub(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		ed25519_genpub(pub, sec);
+}
+
+static void
+b_sign(int n, size_t len)
+{
+	while (n--)
+		ed25519_sign(sig, sec, pub, msg, len);
+}
+
+static void
+b_verify(int n, size_t len)
+{
+	while (n--)
+		ed25519_verify(sig, pub, msg, len);
+}
+
+static void
+b_x25519(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		x25519(out, sec, point);
+}
+
+static void
+b_x25519_base(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		x25519_base(out, sec);
+}
+
+static void
+b_pk_convert(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		pk_ed25519_to_x25519(out, pub);
+}
+
+static void
+b_sk_convert(int n, size_t len)
+{
+	(void)len;
+	while (n--)
+		sk_ed25519_to_x25519(out, sec);
+}
+
+
+/*
+ * set_sig - signs the message of length len for b_verify
+ */
+static void
+set_sig(size_t len)
+{
+	ed25519_sign(sig, sec, pub, msg, len);
+}
+
+
+static const struct {
+	const char	*name;
+	void		(*fn)(int n, size_t len);
+	void		(*setup)(size_t len);
+	int		calls;		/* per sample */
+	int		flags;
+} benches[] = {
+	{ "fld_mul",			b_fld_mul,		NULL,	1000,	0 },
+	{ "fld_sq",			b_fld_sq,		NULL,	1000,	0 },
+	{ "fld_inv",			b_fld_inv,		NULL,	20,	0 },
+	{ "sc_mul",			b_sc_mul,		NULL,	1000,	0 },
+	{ "sc_barrett",			b_sc_barrett,		NULL,	1000,	0 },
+	{ "ed_scale_base",		b_ed_scale_base,	NULL,	10,	0 },
+	{ "ed_dual_scale",		b_ed_dual_scale,	NULL,	5,	0 },
+	{ "sha512",			b_sha512,		NULL,	10,	SWEEP|PER_BYTE },
+	{ "ed25519_genpub",		b_genpub,		NULL,	5,	0 },
+	{ "ed25519_sign",		b_sign,			NULL,	5,	SWEEP },
+	{ "ed25519_verify",		b_verify,		set_sig, 5,	SWEEP },
+	{ "x25519",			b_x25519,		NULL,	5,	0 },
+	{ "x25519_base",		b_x25519_base,		NULL,	5,	0 },
+	{ "pk_ed25519_to_x25519",	b_pk_convert,		NULL,	10,	0 },
+	{ "sk_ed25519_to_x25519",	b_sk_convert,		NULL,	100,	0 },
+};
+
+static const size_t sizes[] = { 0, 64, 256, 1024, 4096, MAX_LEN };
+
+
+#define NBENCHES	(sizeof(benches) / sizeof(benches[0]))
+#define NSIZES		(sizeof(sizes) / sizeof(sizes[0]))
+
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/*
+ * run - takes the samples of benchmark i with messages of length len and
+ * prints the result as json object.
+ */
+static void
+run(unsigned int i, size_t len, double *s, int samples, int first)
+{
+	uint64_t t;
+	int k;
+
+	if (benches[i].setup != NULL)
+		benches[i].setup(len);
+
+	/* the first run warms up the caches and is not counted */
+	for (k = -1; k < samples; k++) {
+		t = ticks();
+		benches[i].fn(benches[i].calls, len);
+		t = ticks() - t;
+
+		if (k >= 0)
+			s[k] = (double)t / benches[i].calls;
+	}
+
+	qsort(s, samples, sizeof(double), cmp_double);
+
+	printf("%s\n    { \"name\": \"%s\", \"len\": %lu, "
+	       "\"q1\": %.1f, \"median\": %.1f, \"q3\": %.1f",
+	       first ? "" : ",", benches[i].name, (unsigned long)len,
+	       s[(samples-1) / 4], s[(samples-1) / 2], s[3*(samples-1) / 4]);
+	if ((benches[i].flags & PER_BYTE) && len > 0)
+		printf(", \"per_byte\": %.2f", s[(samples-1) / 2] / len);
+	printf(" }");
+}
+
+
+/*
+ * selected - whether benchmark i starts with one of the names
+ */
+static int
+selected(unsigned int i, char *names[], int n)
+{
+	int k;
+
+	if (n == 0)
+		return 1;
+
+	for (k = 0; k < n; k++) {
+		if (strncmp(benches[i].name, names[k], strlen(names[k])) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+static void
+print_config(int samples)
+{
+	int avx2 = 0, avx512 = 0, engine = 0;
+	const char *clean;
+
+#ifdef USE_AVX2
+	avx2 = cpu_has_avx2();
+#endif
+#ifdef USE_AVX512
+	avx512 = cpu_has_avx512f();
+#endif
+#ifdef USE_ED_ENGINE
+	engine = 1;
+#endif
+
+#if defined(USE_PRECISE_CLEAN)
+	clean = "precise";
+#elif defined(USE_STACKCLEAN)
+	clean = "full";
+#else
+	clean = "none";
+#endif
+
+	printf("{\n  \"config\": { \"bitness\": %d, \"avx2\": %s, "
+	       "\"avx512\": %s, \"ed_engine\": %s, \"stackclean\": \"%s\", "
+	       "\"unit\": \"%s\", \"samples\": %d },\n",
+	       (int)(8 * sizeof(limb_t)), avx2 ? "true" : "false",
+	       avx512 ? "true" : "false", engine ? "true" : "false",
+	       clean, TIMER_UNIT, samples);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	uint8_t buf[64];
+	double *s;
+	unsigned int i, j;
+	int samples = SAMPLES, first = 1, k;
+
+	for (k = 1; k < argc && argv[k][0] == '-'; k++) {
+		if (strcmp(argv[k], "-s") == 0 && k + 1 < argc) {
+			samples = atoi(argv[++k]);
+		} else {
+			fprintf(stderr, "usage: %s [-s samples] [name ...]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (samples < 1) {
+		fprintf(stderr, "eddsa-bench: need at least one sample\n");
+		return 1;
+	}
+
+	s = malloc(samples * sizeof(double));
+	if (s == NULL)
+		return 1;
+
+	srand(0);
+
+	/* use pseudo-random for test keys (DO NOT DO THIS FOR REAL!) */
+	for (j = 0; j < ED25519_KEY_LEN; j++)
+		sec[j] = (uint8_t)rand();
+	for (j = 0; j < MAX_LEN; j++)
+		msg[j] = (uint8_t)rand();
+
+	ed25519_genpub(pub, sec);
+	pk_ed25519_to_x25519(point, pub);
+
+	for (j = 0; j < sizeof(buf); j++)
+		buf[j] = (uint8_t)rand();
+	fld_import(fa, buf);
+	fld_import(fb, buf + 32);
+	sc_import(sa, buf, 32);
+	sc_import(sb, buf + 32, 32);
+	ed_import(&P, pub);
+
+	/* a carried product of two reduced scalars is below 2^505 */
+	for (j = 0; j < 2*SC_LIMB_NUM; j++)
+		lx[j] = (limb_t)rand() & SC_LIMB_MASK;
+	lx[2*SC_LIMB_NUM-1] &= SC_LIMB_MASK >> 15;
+
+	print_config(samples);
+	printf("  \"results\": [");
+
+	for (i = 0; i < NBENCHES; i++) {
+		if (!selected(i, argv + k, argc - k))
+			continue;
+
+		if (!(benches[i].flags & SWEEP)) {
+			run(i, 0, s, samples, first);
+			first = 0;
+			continue;
+		}
+
+		for (j = 0; j < NSIZES; j++) {
+			run(i, sizes[j], s, samples, first);
+			first = 0;
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	free(s);
+
+	return 0;
+}
@@ -1,5 +1,13 @@
+/* for explicit_bzero and memset_s */
+#define _DEFAULT_SOURCE
+#define __STDC_WANT_LIB_EXT1__	1
+
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+
+#include "burn.h"
+
 
 /*
  * burn - simple function to zero a buffer, used to cover our tracks
@@ -7,8 +15,18 @@
 void
 burn(void *dest, size_t len)
 {
+#if defined(HAVE_MEMSET_S)
+	memset_s(dest, len, 0, len);
+#elif defined(HAVE_EXPLICIT_BZERO)
+	explicit_bzero(dest, len);
+#elif defined(__GNUC__)
+	/* the empty asm makes the compiler believe the zeros are used */
+	memset(dest, 0, len);
+	__asm__ __volatile__("" : : "r"(dest) : "memory");
+#else
 	volatile uint8_t *p = (uint8_t *)dest;
 	const uint8_t *end = (uint8_t *)dest+len;
 
 	while (p < end) *p++ = 0;
+#endif
 }
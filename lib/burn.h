@@ -3,23 +3,24 @@
 
 #include <stddef.h>
 
-#include "compat.h"
 
+void	burn(void *dest, size_t len);
 
-#if defined(HAVE_MEMSET_S)
-
-#include <string.h>
-static INLINE void burn(void *dest, size_t len) { memset_s(dest, len, 0, len); }
-
-#elif defined(HAVE_EXPLICIT_BZERO)
-
-#include <string.h>
-static INLINE void burn(void *dest, size_t len) { explicit_bzero(dest, len); }
 
+/*
+ * burnlocal - wipes a secret local variable (no pointer!) before it goes
+ * out of scope. this is only done with USE_PRECISE_CLEAN, otherwise the
+ * public functions clean up their whole stack with burnstack.
+ *
+ * the precise mode has its limits: the temporaries inside the field and
+ * scalar arithmetic (e.g. the products in fld_mul) and register spills
+ * made by the compiler are not wiped, only the named locals holding
+ * secrets or the state derived from them.
+ */
+#ifdef USE_PRECISE_CLEAN
+#define burnlocal(var)	burn(&(var), sizeof(var))
 #else
-
-void	burn(void *dest, size_t len);
-
+#define burnlocal(var)	((void)0)
 #endif
 
 
@@ -7,15 +7,19 @@
 #ifdef USE_STACKCLEAN
 
 /*
- * burnstack - cleanup our stack
+ * burnstack - cleanup len bytes of our stack (rounded up to 1KB)
+ *
+ * every call has a frame of its own, so this must be neither inlined
+ * into itself nor end in a tail call.
  */
-void
+NOINLINE void
 burnstack(int len)
 {
 	uint8_t stack[1024];
-	burn(stack, 1024);
-	if (len > 0)
+
+	if (len > 1024)
 		burnstack(len-1024);
+	burn(stack, 1024);
 }
 
 #endif
@@ -11,4 +11,17 @@
 #define INLINE inline
 #endif
 
+/*
+ * keep the compiler from inlining a function, e.g. to control the
+ * stack frames of burnstack.
+ */
+
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#elif defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
 #endif
@@ -0,0 +1,40 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "compat.h"
+
+/*
+ * runtime detection of cpu features used by the simd code paths.
+ *
+ * the simd code is only compiled if cmake found a compiler with the
+ * needed support, but we still have to make sure the cpu we are
+ * running on has these instructions.
+ */
+
+#ifdef USE_AVX2
+
+static INLINE int
+cpu_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static INLINE int
+cpu_has_bmi2(void)
+{
+	return __builtin_cpu_supports("bmi2");
+}
+
+#endif
+
+#ifdef USE_AVX512
+
+static INLINE int
+cpu_has_avx512f(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+#endif
+
+#endif
@@ -14,27 +14,17 @@
  *     Hisil, Wong, Carter, Dawson
  */
 
+#include <limits.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "bitness.h"
+#include "burn.h"
 #include "fld.h"
 #include "sc.h"
 #include "ed.h"
 
 
-/*
- * special pre-computed form of a point on the curve, used
- * for the lookup table and some optimizations.
- */
-struct pced {
-	fld_t		diff;		/* y - x */
-	fld_t		sum;		/* y + x */
-	fld_t		prod;		/* 2*d*t */
-};
-
-
-
 #ifdef USE_64BIT
 
 /* lookup-table for ed_scale_base - 64bit version */
@@ -150,15 +140,14 @@ ed_import(struct ed *P, const uint8_t in[32])
 
 
 /*
- * ed_export - export point P to packed 256bit format.
+ * ed_export_affine - helper for ed_export, zinv must be the inverse of P->z.
  */
-void
-ed_export(uint8_t out[32], const struct ed *P)
+static void
+ed_export_affine(uint8_t out[32], const struct ed *P, const fld_t zinv)
 {
-	fld_t x, y, zinv;
+	fld_t x, y;
 
 	/* divide x and y by z to get affine coordinates */
-	fld_inv(zinv, P->z);
 	fld_mul(x, P->x, zinv);
 	fld_mul(y, P->y, zinv);
 	fld_export(out, y);
@@ -169,6 +158,34 @@ ed_export(uint8_t out[32], const struct ed *P)
 }
 
 
+/*
+ * ed_export - export point P to packed 256bit format.
+ */
+void
+ed_export(uint8_t out[32], const struct ed *P)
+{
+	fld_t zinv;
+
+	fld_inv(zinv, P->z);
+	ed_export_affine(out, P, zinv);
+}
+
+
+/*
+ * ed_export_vartime - export point P to packed 256bit format. (vartime)
+ *
+ * Note: use this only for public points like in ed25519_verify().
+ */
+void
+ed_export_vartime(uint8_t out[32], const struct ed *P)
+{
+	fld_t zinv;
+
+	fld_inv_vartime(zinv, P->z);
+	ed_export_affine(out, P, zinv);
+}
+
+
 /*
  * ed_add - add points P and Q
  */
@@ -336,7 +353,8 @@ ed_sub_pc(struct ed *out, const struct ed *P, const struct pced *Q)
 
 
 /*
- * scale16 - helper function for ed_scale_base, returns x * 16^pow * base
+ * scale16 - helper function for ed_scale_comb, returns x * 16^pow * P,
+ * where table holds the multiples of P (see struct ed_table).
  *
  * assumes:
  *  -8 <= x <= 7
@@ -344,7 +362,7 @@ ed_sub_pc(struct ed *out, const struct ed *P, const struct pced *Q)
  *   2 | pow
  */
 static void
-scale16(struct pced *out, int pow, int x)
+scale16(struct pced *out, const struct pced table[][8], int pow, int x)
 {
 	struct pced R = { { 0 }, { 0 }, { 0 } };
 	limb_t mA, mB, mask;
@@ -374,9 +392,9 @@ scale16(struct pced *out, int pow, int x)
 		mask |= mask >> 1;
 		mask = (mask & 1) - 1;
 		for (i = 0; i < FLD_LIMB_NUM; i++) {
-			R.diff[i] ^= ed_lookup[pow][k].diff[i] & mask;
-			R.sum[i] ^= ed_lookup[pow][k].sum[i] & mask;
-			R.prod[i] ^= ed_lookup[pow][k].prod[i] & mask;
+			R.diff[i] ^= table[pow][k].diff[i] & mask;
+			R.sum[i] ^= table[pow][k].sum[i] & mask;
+			R.prod[i] ^= table[pow][k].prod[i] & mask;
 		}
 	}
 
@@ -388,14 +406,17 @@ scale16(struct pced *out, int pow, int x)
 		out->sum[i]  = (mB & R.diff[i]) ^ (mA & R.sum[i]);
 		out->prod[i] = sgnx * R.prod[i];
 	}
+
+	burnlocal(R);
 }
 
 
 /*
- * ed_scale_base - calculates x * base
+ * ed_scale_comb - calculates x * P, where table holds the multiples of P
+ * (see struct ed_table).
  */
-void
-ed_scale_base(struct ed *out, const sc_t x)
+static void
+ed_scale_comb(struct ed *out, const struct pced table[][8], const sc_t x)
 {
 	struct ed R0, R1;
 	struct pced P;
@@ -414,10 +435,10 @@ ed_scale_base(struct ed *out, const sc_t x)
 	memcpy(&R0, &ed_zero, sizeof(struct ed));
 	memcpy(&R1, &ed_zero, sizeof(struct ed));
 	for (i = 0; i < 32; i++) {
-		scale16(&P, 2*i, (pack[i] & 0xf) - 8);
+		scale16(&P, table, 2*i, (pack[i] & 0xf) - 8);
 		ed_add_pc(&R0, &R0, &P);
 
-		scale16(&P, 2*i, (pack[i] >> 4) - 8);
+		scale16(&P, table, 2*i, (pack[i] >> 4) - 8);
 		ed_add_pc(&R1, &R1, &P);
 	}
 
@@ -427,6 +448,227 @@ ed_scale_base(struct ed *out, const sc_t x)
 
 	/* out <- R0 + R1 */
 	ed_add(out, &R0, &R1);
+
+	burnlocal(R0);
+	burnlocal(R1);
+	burnlocal(P);
+	burnlocal(tmp);
+	burnlocal(pack);
+}
+
+
+/*
+ * ed_scale_base - calculates x * base
+ */
+void
+ed_scale_base(struct ed *out, const sc_t x)
+{
+	ed_scale_comb(out, ed_lookup, x);
+}
+
+
+/*
+ * ed_scale_table - calculates x * P, where T was set up for P by
+ * ed_table_init.
+ *
+ * Note: P must have prime order (or be zero), since x is used modulo
+ * the group order.
+ */
+void
+ed_scale_table(struct ed *out, const struct ed_table *T, const sc_t x)
+{
+	ed_scale_comb(out, T->row, x);
+}
+
+
+/*
+ * ed_affine_pc - converts P to affine pre-computed form, where zinv is
+ * the inverse of its z-coordinate.
+ */
+static void
+ed_affine_pc(struct pced *out, const struct ed *P, const fld_t zinv)
+{
+	fld_t x, y, t;
+
+	fld_mul(x, P->x, zinv);
+	fld_mul(y, P->y, zinv);
+	fld_mul(t, x, y);
+
+	fld_sub(out->diff, y, x);
+	fld_add(out->sum, y, x);
+	fld_mul(out->prod, t, con_2d);
+
+	fld_reduce(out->diff, out->diff);
+	fld_reduce(out->sum, out->sum);
+}
+
+
+/*
+ * ed_multiples - calculates row[k] = (k+1) * P in affine pre-computed form
+ * for k = 0, ..., 7 and returns 8 * P in next.
+ */
+static void
+ed_multiples(struct pced row[8], struct ed *next, const struct ed *P)
+{
+	struct ed M[8];
+	fld_t z[8], zinv[8];
+	int k;
+
+	memcpy(&M[0], P, sizeof(struct ed));
+	ed_double(&M[1], &M[0]);
+	for (k = 2; k < 8; k++)
+		ed_add(&M[k], &M[k-1], &M[0]);
+
+	/* convert to affine precomputed form */
+	for (k = 0; k < 8; k++)
+		memcpy(z[k], M[k].z, sizeof(fld_t));
+	fld_inv_batch(zinv, z, 8);
+
+	for (k = 0; k < 8; k++)
+		ed_affine_pc(&row[k], &M[k], zinv[k]);
+
+	memcpy(next, &M[7], sizeof(struct ed));
+}
+
+
+/*
+ * ed_table_init - set up the lookup table of P for ed_scale_table, in
+ * the same format as the lookup table of ed_scale_base.
+ *
+ * this takes 32 inversions and around 500 point operations.
+ */
+void
+ed_table_init(struct ed_table *T, const struct ed *P)
+{
+	struct ed R;
+	int i, k;
+
+	memcpy(&R, P, sizeof(struct ed));
+
+	for (i = 0; i < ED_TABLE_ROWS; i++) {
+		/* T->row[i][k] <- (k+1) * 16^(2*i) * P */
+		ed_multiples(T->row[i], &R, &R);
+
+		/* R <- 16^(2*i+2) * P = 32 * 8 * 16^(2*i) * P */
+		for (k = 0; k < 5; k++)
+			ed_double(&R, &R);
+	}
+}
+
+
+/*
+ * ed_scale - calculates x * P in constant time, using signed 4bit windows
+ * and a table of multiples of P.
+ *
+ * Note: P must have prime order (or be zero), since x is used modulo
+ * the group order.
+ */
+void
+ed_scale(struct ed *out, const struct ed *P, const sc_t x)
+{
+	struct pced table[1][8];
+	struct pced Q;
+	struct ed R;
+	sc_t tmp;
+	uint8_t pack[32];
+	int i, k, digit;
+
+	ed_multiples(table[0], &R, P);
+
+	/* s <- x + 8 * (16^64 - 1) / 15, so every nibble minus 8 is a digit */
+	sc_add(tmp, x, con_off);
+	sc_export(pack, tmp);
+
+	memcpy(&R, &ed_zero, sizeof(struct ed));
+	for (i = 63; i >= 0; i--) {
+		for (k = 0; k < 4 && i < 63; k++)
+			ed_double(&R, &R);
+
+		digit = ((pack[i >> 1] >> (4 * (i & 1))) & 0xf) - 8;
+		scale16(&Q, (const struct pced (*)[8])table, 0, digit);
+		ed_add_pc(&R, &R, &Q);
+	}
+
+	memcpy(out, &R, sizeof(struct ed));
+
+	burnlocal(R);
+	burnlocal(Q);
+	burnlocal(tmp);
+	burnlocal(pack);
+	burnlocal(digit);
+}
+
+
+/*
+ * ed_base - returns the base point B in projective form.
+ */
+void
+ed_base(struct ed *out)
+{
+	ed_add_pc(out, &ed_zero, &pced_B);
+}
+
+
+/*
+ * ed_clear_cofactor - calculates 8 * P, which lies in the subgroup of
+ * prime order.
+ */
+void
+ed_clear_cofactor(struct ed *out, const struct ed *P)
+{
+	ed_double(out, P);
+	ed_double(out, out);
+	ed_double(out, out);
+}
+
+
+/*
+ * ed_cofactor_eq - checks if 8*P = 8*Q, ie. if P and Q only differ by a
+ * point of small order. (vartime)
+ *
+ * returns 1 if so and 0 otherwise.
+ */
+int
+ed_cofactor_eq(const struct ed *P, const struct ed *Q)
+{
+	struct ed D;
+
+	ed_sub(&D, P, Q);
+	ed_clear_cofactor(&D, &D);
+
+	return ed_is_neutral(&D);
+}
+
+
+/*
+ * ed_on_curve - checks if P lies on the curve, ie. if
+ *   -x^2 + y^2 = z^2 + d * x^2 * y^2 / z^2	and	x*y = z*t
+ *
+ * returns 1 if so and 0 otherwise.
+ */
+int
+ed_on_curve(const struct ed *P)
+{
+	fld_t xx, yy, zz, l, r;
+
+	fld_sq(xx, P->x);
+	fld_sq(yy, P->y);
+	fld_sq(zz, P->z);
+
+	/* l <- (y^2 - x^2) * z^2,  r <- z^4 + d * x^2 * y^2 */
+	fld_sub(l, yy, xx);
+	fld_mul(l, l, zz);
+
+	fld_sq(r, zz);
+	fld_mul(xx, xx, yy);
+	fld_mul(xx, xx, con_d);
+	fld_add(r, r, xx);
+
+	/* xx <- x*y,  yy <- z*t */
+	fld_mul(xx, P->x, P->y);
+	fld_mul(yy, P->z, P->t);
+
+	return fld_eq(l, r) & fld_eq(xx, yy);
 }
 
 
@@ -442,6 +684,92 @@ ed_precompute(struct pced *R, const struct ed *P)
 }
 
 
+/*
+ * ed_dual_start - prepares s for the calculation of x*base + y*Q by
+ * ed_dual_step.  (vartime)
+ *
+ * assumes:
+ *   Q is affine, ie has z = 1
+ *   x and y must be reduced
+ */
+void
+ed_dual_start(struct ed_dual *s, const sc_t x, const sc_t y,
+	      const struct ed *Q)
+{
+	memcpy(&s->R, &ed_zero, sizeof(struct ed));
+	s->dbl = 0;
+
+	/* calculate joint sparse form of x and y */
+	s->i = sc_jsf(s->ux, s->uy, x, y);
+	if (s->i == -1)
+		return;
+
+	/* precompute Q, Q+B and Q-B */
+	ed_add_pc(&s->QpB, Q, &pced_B);
+	ed_sub_pc(&s->QmB, Q, &pced_B);
+	ed_precompute(&s->pcQ, Q);
+}
+
+
+/*
+ * ed_dual_step - continues the calculation of ed_dual_start with at most
+ * ops point additions or doublings, using fast shamir method.  (vartime)
+ *
+ * the calculation is finished if s->i < 0, then s->R holds the result.
+ *
+ * returns the number of unused ops.
+ */
+int
+ed_dual_step(struct ed_dual *s, int ops)
+{
+	struct ed *R = &s->R;
+	int i;
+
+	while (s->i >= 0 && ops > 0) {
+		i = s->i;
+
+		/* the doubling between two digits */
+		if (s->dbl) {
+			ed_double(R, R);
+			s->dbl = 0;
+			ops--;
+			continue;
+		}
+
+		if (s->ux[i] == 1) {
+			if (s->uy[i] == 1)
+				ed_add(R, R, &s->QpB);
+			else if (s->uy[i] == -1)
+				ed_sub(R, R, &s->QmB);
+			else
+				ed_add_pc(R, R, &pced_B);
+			ops--;
+
+		} else if (s->ux[i] == -1) {
+			if (s->uy[i] == 1)
+				ed_add(R, R, &s->QmB);
+			else if (s->uy[i] == -1)
+				ed_sub(R, R, &s->QpB);
+			else
+				ed_sub_pc(R, R, &pced_B);
+			ops--;
+
+		} else if (s->uy[i] != 0) {
+			if (s->uy[i] == 1)
+				ed_add_pc(R, R, &s->pcQ);
+			else
+				ed_sub_pc(R, R, &s->pcQ);
+			ops--;
+		}
+
+		s->i--;
+		s->dbl = (s->i >= 0);
+	}
+
+	return ops;
+}
+
+
 /*
  * ed_dual_scale - calculates R = x*base + y*Q.  (vartime)
  *
@@ -457,51 +785,386 @@ ed_dual_scale(struct ed *R,
 	      const sc_t x,
 	      const sc_t y, const struct ed *Q)
 {
-	struct ed QpB, QmB;
-	struct pced pcQ;
+	struct ed_dual s;
+
+	ed_dual_start(&s, x, y, Q);
+	ed_dual_step(&s, INT_MAX);
+
+	memcpy(R, &s.R, sizeof(struct ed));
+}
+
 
-	int ux[SC_BITS+1], uy[SC_BITS+1];
-	int n, i;
+/*
+ * ed_double2 - doubles P0 and P1 in place, with the independent field
+ * operations of both interleaved (see ed_double).
+ */
+static void
+ed_double2(struct ed *P0, struct ed *P1)
+{
+	fld_t a0, b0, c0, d0, e0, f0, g0, h0;
+	fld_t a1, b1, c1, d1, e1, f1, g1, h1;
+
+	fld_sub(a0, P0->y, P0->x);
+	fld_sub(a1, P1->y, P1->x);
+	fld_sq(a0, a0);
+	fld_sq(a1, a1);
+
+	fld_add(b0, P0->y, P0->x);
+	fld_add(b1, P1->y, P1->x);
+	fld_sq(b0, b0);
+	fld_sq(b1, b1);
+
+	fld_sq(c0, P0->t);
+	fld_sq(c1, P1->t);
+	fld_mul(c0, c0, con_2d);
+	fld_mul(c1, c1, con_2d);
+
+	fld_sq(d0, P0->z);
+	fld_sq(d1, P1->z);
+	fld_scale2(d0, d0);
+	fld_scale2(d1, d1);
+
+	fld_sub(e0, b0, a0);
+	fld_sub(e1, b1, a1);
+	fld_sub(f0, d0, c0);
+	fld_sub(f1, d1, c1);
+	fld_add(g0, d0, c0);
+	fld_add(g1, d1, c1);
+	fld_add(h0, b0, a0);
+	fld_add(h1, b1, a1);
+
+	fld_mul(P0->x, e0, f0);
+	fld_mul(P1->x, e1, f1);
+	fld_mul(P0->y, g0, h0);
+	fld_mul(P1->y, g1, h1);
+	fld_mul(P0->t, e0, h0);
+	fld_mul(P1->t, e1, h1);
+	fld_mul(P0->z, f0, g0);
+	fld_mul(P1->z, f1, g1);
+}
+
+
+/*
+ * ed_add_pc2 - adds Q0 to P0 and Q1 to P1 in place, with the independent
+ * field operations of both interleaved (see ed_add_pc).
+ */
+static void
+ed_add_pc2(struct ed *P0, const struct pced *Q0,
+	   struct ed *P1, const struct pced *Q1)
+{
+	fld_t a0, b0, c0, d0, e0, f0, g0, h0;
+	fld_t a1, b1, c1, d1, e1, f1, g1, h1;
+
+	fld_sub(a0, P0->y, P0->x);
+	fld_sub(a1, P1->y, P1->x);
+	fld_mul(a0, a0, Q0->diff);
+	fld_mul(a1, a1, Q1->diff);
+
+	fld_add(b0, P0->y, P0->x);
+	fld_add(b1, P1->y, P1->x);
+	fld_mul(b0, b0, Q0->sum);
+	fld_mul(b1, b1, Q1->sum);
+
+	fld_mul(c0, P0->t, Q0->prod);
+	fld_mul(c1, P1->t, Q1->prod);
+	fld_scale2(d0, P0->z);
+	fld_scale2(d1, P1->z);
+
+	fld_sub(e0, b0, a0);
+	fld_sub(e1, b1, a1);
+	fld_sub(f0, d0, c0);
+	fld_sub(f1, d1, c1);
+	fld_add(g0, d0, c0);
+	fld_add(g1, d1, c1);
+	fld_add(h0, b0, a0);
+	fld_add(h1, b1, a1);
+
+	fld_mul(P0->x, e0, f0);
+	fld_mul(P1->x, e1, f1);
+	fld_mul(P0->y, g0, h0);
+	fld_mul(P1->y, g1, h1);
+	fld_mul(P0->t, e0, h0);
+	fld_mul(P1->t, e1, h1);
+	fld_mul(P0->z, f0, g0);
+	fld_mul(P1->z, f1, g1);
+}
+
+
+/* index of the point u*B + v*Q in the tables of ed_dual_scale2 */
+#define DUAL_IDX(u, v)	(3 * ((u) + 1) + (v) + 1)
+
+/* the points B, Q, Q+B and Q-B, the other ones are their negatives */
+static const int dual_pos[4] = {
+	DUAL_IDX(1, 0), DUAL_IDX(0, 1), DUAL_IDX(1, 1), DUAL_IDX(-1, 1)
+};
+
+
+/*
+ * ed_dual_scale2 - calculates R[k] = x[k]*base + y[k]*Q[k] for k = 0, 1
+ * with the point operations of both interleaved.  (vartime)
+ *
+ * like ed_dual_scale this runs the fast shamir method on the joint
+ * sparse forms, but all points to add are brought to affine
+ * pre-computed form first. so both results only take ed_double2 and
+ * ed_add_pc2 and the cpu can overlap their independent multiplications.
+ *
+ * Note: This algorithms does NOT run in constant time! Please use this
+ * only for public information like in ed25519_verify2().
+ *
+ * assumes:
+ *   Q[k] is affine, ie has z = 1
+ *   x[k] and y[k] must be reduced
+ */
+void
+ed_dual_scale2(struct ed R[2], const sc_t x[2], const sc_t y[2],
+	       const struct ed Q[2])
+{
+	struct pced pc[2][9];
+	struct ed M[4];
+	fld_t z[4], zinv[4], zero;
+	int8_t ux[2][SC_BITS+1], uy[2][SC_BITS+1];
+	int n, i, j, k, d0, d1;
+
+	n = -1;
+	for (k = 0; k < 2; k++) {
+		i = sc_jsf(ux[k], uy[k], x[k], y[k]);
+		if (i > n)
+			n = i;
+
+		ed_add_pc(&M[2*k], &Q[k], &pced_B);
+		ed_sub_pc(&M[2*k+1], &Q[k], &pced_B);
+	}
+
+	/*
+	 * Q+B or Q-B can only be the neutral element at infinity if Q is
+	 * not on the curve. do it the old way then, to get the same result.
+	 */
+	fld_set0(zero, 0);
+	for (k = 0; k < 4; k++) {
+		fld_reduce(z[k], M[k].z);
+		if (fld_eq(z[k], zero)) {
+			ed_dual_scale(&R[0], x[0], y[0], &Q[0]);
+			ed_dual_scale(&R[1], x[1], y[1], &Q[1]);
+			return;
+		}
+	}
+
+	fld_inv_batch_vartime(zinv, z, 4);
+
+	/* pc[k] holds all eight non-zero u*B + v*Q with u, v in {-1,0,1} */
+	for (k = 0; k < 2; k++) {
+		memcpy(&pc[k][DUAL_IDX(1, 0)], &pced_B, sizeof(struct pced));
+		ed_precompute(&pc[k][DUAL_IDX(0, 1)], &Q[k]);
+		ed_affine_pc(&pc[k][DUAL_IDX(1, 1)], &M[2*k], zinv[2*k]);
+		ed_affine_pc(&pc[k][DUAL_IDX(-1, 1)], &M[2*k+1], zinv[2*k+1]);
+
+		/* -P has swapped diff and sum and negated prod */
+		for (i = 0; i < 4; i++) {
+			j = dual_pos[i];
+			memcpy(pc[k][8-j].diff, pc[k][j].sum, sizeof(fld_t));
+			memcpy(pc[k][8-j].sum, pc[k][j].diff, sizeof(fld_t));
+			fld_neg(pc[k][8-j].prod, pc[k][j].prod);
+		}
+	}
+
+	memcpy(&R[0], &ed_zero, sizeof(struct ed));
+	memcpy(&R[1], &ed_zero, sizeof(struct ed));
+
+	for (i = n; i >= 0; i--) {
+		d0 = DUAL_IDX(ux[0][i], uy[0][i]);
+		d1 = DUAL_IDX(ux[1][i], uy[1][i]);
+
+		if (d0 != DUAL_IDX(0, 0) && d1 != DUAL_IDX(0, 0))
+			ed_add_pc2(&R[0], &pc[0][d0], &R[1], &pc[1][d1]);
+		else if (d0 != DUAL_IDX(0, 0))
+			ed_add_pc(&R[0], &R[0], &pc[0][d0]);
+		else if (d1 != DUAL_IDX(0, 0))
+			ed_add_pc(&R[1], &R[1], &pc[1][d1]);
+
+		if (i > 0)
+			ed_double2(&R[0], &R[1]);
+	}
+}
+
+
+/*
+ * ed_multi_scale - calculates R = x[0]*P[0] + ... + x[n-1]*P[n-1]
+ * (vartime) with straus' method on width-ED_MULTI_WINDOW naf digits.
+ *
+ * the caller provides n scratch entries, which keep the odd multiples
+ * and digits of every point.
+ *
+ * Note: This algorithms does NOT run in constant time! Please use this
+ * only for public information like in ed25519_verify_batch().
+ *
+ * assumes:
+ *   all x[i] must be reduced
+ */
+void
+ed_multi_scale(struct ed *R, int n, const sc_t x[], const struct ed P[],
+	       struct ed_multi scratch[])
+{
+	struct ed P2;
+	int top, i, j, d;
+
+	top = -1;
+	for (j = 0; j < n; j++) {
+		scratch[j].top = sc_wnaf(scratch[j].naf, x[j], ED_MULTI_WINDOW);
+		if (scratch[j].top < 0)
+			continue;
+		if (scratch[j].top > top)
+			top = scratch[j].top;
+
+		/* odd[k] <- (2k+1) * P */
+		memcpy(&scratch[j].odd[0], &P[j], sizeof(struct ed));
+		ed_double(&P2, &P[j]);
+		for (i = 1; i < ED_MULTI_ODD; i++)
+			ed_add(&scratch[j].odd[i], &scratch[j].odd[i-1], &P2);
+	}
 
 	memcpy(R, &ed_zero, sizeof(struct ed));
 
-	/* calculate joint sparse form of x and y */
-	n = sc_jsf(ux, uy, x, y);
-	if (n == -1)
-		return;
+	for (i = top; i >= 0; i--) {
+		if (i < top)
+			ed_double(R, R);
 
-	/* precompute Q, Q+B and Q-B */
-	ed_add_pc(&QpB, Q, &pced_B);
-	ed_sub_pc(&QmB, Q, &pced_B);
-	ed_precompute(&pcQ, Q);
-	
-	/* now we calculate R = x * base_point + y * Q using fast shamir method */
-	for (i = n; ; i--) {
-		if (ux[i] == 1) {
-			if (uy[i] == 1)
-				ed_add(R, R, &QpB);
-			else if (uy[i] == -1)
-				ed_sub(R, R, &QmB);
-			else
-				ed_add_pc(R, R, &pced_B);
-			
-		} else if (ux[i] == -1) {
-			if (uy[i] == 1)
-				ed_add(R, R, &QmB);
-			else if (uy[i] == -1)
-				ed_sub(R, R, &QpB);
-			else
-				ed_sub_pc(R, R, &pced_B);
+		for (j = 0; j < n; j++) {
+			if (i > scratch[j].top)
+				continue;
+
+			d = scratch[j].naf[i];
+			if (d > 0)
+				ed_add(R, R, &scratch[j].odd[d >> 1]);
+			else if (d < 0)
+				ed_sub(R, R, &scratch[j].odd[(-d) >> 1]);
+		}
+	}
+}
+
+
+/*
+ * ed_is_neutral - checks if P is the neutral element (0 : 1). (vartime)
+ *
+ * returns 1 if so and 0 otherwise.
+ */
+int
+ed_is_neutral(const struct ed *P)
+{
+	fld_t zero;
+
+	fld_set0(zero, 0);
+
+	return fld_eq(P->x, zero) & fld_eq(P->y, P->z);
+}
+
+
+/*
+ * ed_hot_init - set up the table of P for ed_dual_scale_hot, with
+ *
+ *	table[i * 2^(w-1) + k] = (k+1) * 2^(w*i) * P
+ *
+ * for i < SC_RADIX_DIGITS(w) and k < 2^(w-1) in affine pre-computed
+ * form. (vartime)
+ *
+ * assumes:
+ *   4 <= w <= 16
+ */
+void
+ed_hot_init(struct pced *table, int w, const struct ed *P)
+{
+	struct ed M[ED_HOT_CHUNK];
+	fld_t z[ED_HOT_CHUNK], zinv[ED_HOT_CHUNK];
+	struct ed R, S;
+	int rows, cols, i, j, k, n;
+
+	rows = SC_RADIX_DIGITS(w);
+	cols = 1 << (w-1);
+
+	memcpy(&R, P, sizeof(struct ed));
+
+	for (i = 0; i < rows; i++) {
+		/* R = 2^(w*i) * P, S runs through its multiples */
+		memcpy(&S, &R, sizeof(struct ed));
+
+		for (k = 0; k < cols; k += n) {
+			n = (cols - k < ED_HOT_CHUNK) ? cols - k : ED_HOT_CHUNK;
+
+			for (j = 0; j < n; j++) {
+				memcpy(&M[j], &S, sizeof(struct ed));
+				memcpy(z[j], S.z, sizeof(fld_t));
+				ed_add(&S, &S, &R);
+			}
 
-		} else {
-			if (uy[i] == 1)
-				ed_add_pc(R, R, &pcQ);
-			else if (uy[i] == -1)
-				ed_sub_pc(R, R, &pcQ);
+			fld_inv_batch_vartime(zinv, z, n);
+			for (j = 0; j < n; j++)
+				ed_affine_pc(&table[i*cols + k + j], &M[j],
+					     zinv[j]);
 		}
 
-		if (i == 0) break;
+		/* S = (2^(w-1) + 1) * R, so 2^w * R = 2 * (S - R) */
+		ed_sub(&S, &S, &R);
+		ed_double(&R, &S);
+	}
+}
+
+
+/*
+ * ed_dual_scale_hot - calculates R = x*base + y*P, where table was set up
+ * for P by ed_hot_init with window w.  (vartime)
+ *
+ * both scalings are done with lookup tables, only the even rows of the
+ * base point table need four doublings at the end.
+ *
+ * Note: This algorithms does NOT run in constant time! Please use this
+ * only for public information like in ed25519_verify_hotkey().
+ *
+ * assumes:
+ *   x and y must be reduced
+ */
+void
+ed_dual_scale_hot(struct ed *R, const sc_t x, const sc_t y,
+		  const struct pced *table, int w)
+{
+	struct ed R0, R1;
+	int16_t u[SC_RADIX_DIGITS(4)];
+	sc_t tmp;
+	uint8_t pack[32];
+	int i, n, d, cols;
+
+	/* nibbles of x + 8 * (16^64 - 1) / 15 minus 8, like ed_scale_comb */
+	sc_add(tmp, x, con_off);
+	sc_export(pack, tmp);
 
-		ed_double(R, R);
+	memcpy(&R0, &ed_zero, sizeof(struct ed));
+	memcpy(&R1, &ed_zero, sizeof(struct ed));
+	for (i = 0; i < 32; i++) {
+		d = (pack[i] & 0xf) - 8;
+		if (d > 0)
+			ed_add_pc(&R0, &R0, &ed_lookup[i][d-1]);
+		else if (d < 0)
+			ed_sub_pc(&R0, &R0, &ed_lookup[i][-d-1]);
+
+		d = (pack[i] >> 4) - 8;
+		if (d > 0)
+			ed_add_pc(&R1, &R1, &ed_lookup[i][d-1]);
+		else if (d < 0)
+			ed_sub_pc(&R1, &R1, &ed_lookup[i][-d-1]);
 	}
+
+	/* R0 += y * P, one table entry per digit */
+	cols = 1 << (w-1);
+	n = sc_radix(u, y, w);
+	for (i = 0; i < n; i++) {
+		d = u[i];
+		if (d > 0)
+			ed_add_pc(&R0, &R0, &table[i*cols + d-1]);
+		else if (d < 0)
+			ed_sub_pc(&R0, &R0, &table[i*cols - d-1]);
+	}
+
+	/* R <- R0 + 16 * R1 */
+	for (i = 0; i < 4; i++)
+		ed_double(&R1, &R1);
+
+	ed_add(R, &R0, &R1);
 }
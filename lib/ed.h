@@ -18,12 +18,98 @@ struct ed {
 };
 
 
+/*
+ * special pre-computed form of a point on the curve, used
+ * for the lookup table and some optimizations.
+ */
+struct pced {
+	fld_t		diff;		/* y - x */
+	fld_t		sum;		/* y + x */
+	fld_t		prod;		/* 2*d*t */
+};
+
+
+/*
+ * lookup table for ed_scale_table: row[i][k] holds (k+1) * 16^(2*i) * P
+ * in affine pre-computed form.
+ */
+#define ED_TABLE_ROWS	32
+
+struct ed_table {
+	struct pced	row[ED_TABLE_ROWS][8];
+};
+
+
+/*
+ * state of a resumable ed_dual_scale, see ed_dual_start and ed_dual_step.
+ * i is the next digit of the joint sparse form of the scalars and dbl
+ * tells if R has to be doubled before.
+ */
+struct ed_dual {
+	struct ed	R;
+	struct ed	QpB;
+	struct ed	QmB;
+	struct pced	pcQ;
+
+	int8_t		ux[SC_BITS+1];
+	int8_t		uy[SC_BITS+1];
+	int		i;
+	int		dbl;
+};
+
+
+/*
+ * scratch space of ed_multi_scale for one point: the odd multiples
+ * P, 3P, ..., (2^(w-1) - 1)P and the naf digits of its scalar. a window
+ * of 5 is hardly faster, but takes 1.7 times the memory.
+ */
+#define ED_MULTI_WINDOW	4
+#define ED_MULTI_ODD	(1 << (ED_MULTI_WINDOW - 2))
+
+struct ed_multi {
+	struct ed	odd[ED_MULTI_ODD];
+	int8_t		naf[SC_BITS+1];
+	int		top;
+};
+
+
 void	ed_export(uint8_t out[32], const struct ed *P);
+void	ed_export_vartime(uint8_t out[32], const struct ed *P);
 void	ed_import(struct ed *P, const uint8_t in[32]);
 
 void	ed_scale_base(struct ed *res, const sc_t x);
+void	ed_scale(struct ed *res, const struct ed *P, const sc_t x);
+
+void	ed_table_init(struct ed_table *T, const struct ed *P);
+void	ed_scale_table(struct ed *res, const struct ed_table *T, const sc_t x);
+
+/*
+ * variable-time table of a fixed point for ed_dual_scale_hot, which
+ * takes ED_HOT_ENTRIES(w) points (see ed_hot_init). it is set up in
+ * chunks of ED_HOT_CHUNK points sharing one inversion, which ed_hot_init
+ * keeps on the stack.
+ */
+#define ED_HOT_ENTRIES(w)	(SC_RADIX_DIGITS(w) << ((w) - 1))
+#define ED_HOT_CHUNK		32
+
+void	ed_hot_init(struct pced *table, int w, const struct ed *P);
+void	ed_dual_scale_hot(struct ed *R, const sc_t x, const sc_t y,
+			  const struct pced *table, int w);
+
+void	ed_base(struct ed *out);
+void	ed_clear_cofactor(struct ed *out, const struct ed *P);
+int	ed_cofactor_eq(const struct ed *P, const struct ed *Q);
+int	ed_on_curve(const struct ed *P);
 
 void	ed_dual_scale(struct ed *R, const sc_t x,
 		      const sc_t y, const struct ed *Q);
+void	ed_dual_start(struct ed_dual *s, const sc_t x, const sc_t y,
+		      const struct ed *Q);
+int	ed_dual_step(struct ed_dual *s, int ops);
+void	ed_dual_scale2(struct ed R[2], const sc_t x[2], const sc_t y[2],
+		       const struct ed Q[2]);
+void	ed_multi_scale(struct ed *R, int n, const sc_t x[],
+		       const struct ed P[], struct ed_multi scratch[]);
+int	ed_is_neutral(const struct ed *P);
 
 #endif
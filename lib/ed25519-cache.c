@@ -0,0 +1,313 @@
+/*
+ * cache of ed25519 verification results.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * A signature is looked up by a keyed digest
+ *
+ *	d = SHA512(key, pub, sig, data) truncated to 256bit,
+ *
+ * where key is a random secret of the cache. Nobody outside knows the
+ * digests, so no one can compute a (pub, sig, data) which collides with
+ * a cached one or aim many signatures at the same set of the cache.
+ * The digest covers the whole signature and message, so a result is
+ * never reused for a different message or a malleated signature.
+ *
+ * The cache is set-associative with CACHE_WAYS entries per set, which
+ * are kept in LRU order. The sets are protected by a fixed number of
+ * mutexes, so threads only contend if they hit sets sharing a lock.
+ * The cache lives in memory of the caller, followed by its sets.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "eddsa.h"
+
+#include "sha512.h"
+#include "burn.h"
+#include "random.h"
+#include "scratch.h"
+
+
+#define CACHE_DIGEST_LEN	32
+#define CACHE_WAYS		4
+#define CACHE_LOCKS		64
+
+
+#define COUNT(p)	__atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+
+
+struct entry {
+	uint8_t		digest[CACHE_DIGEST_LEN];
+	uint8_t		used;
+	uint8_t		ok;
+};
+
+struct set {
+	struct entry	way[CACHE_WAYS];	/* most recent first */
+};
+
+struct ed25519_cache {
+	struct set	*sets;
+	size_t		mask;		/* number of sets - 1 */
+	unsigned int	flags;
+
+	uint8_t		key[32];
+
+	pthread_mutex_t	lock[CACHE_LOCKS];
+
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	inserts;
+	uint64_t	evictions;
+};
+
+
+/*
+ * cache_digest - calculates the keyed digest of a signature
+ */
+static void
+cache_digest(uint8_t digest[CACHE_DIGEST_LEN],
+	     const struct ed25519_cache *cache,
+	     const uint8_t sig[ED25519_SIG_LEN],
+	     const uint8_t pub[ED25519_KEY_LEN],
+	     const uint8_t *data, size_t len)
+{
+	struct sha512 hash;
+	uint8_t h[SHA512_HASH_LENGTH];
+
+	sha512_init(&hash);
+	sha512_add(&hash, cache->key, sizeof(cache->key));
+	sha512_add(&hash, pub, ED25519_KEY_LEN);
+	sha512_add(&hash, sig, ED25519_SIG_LEN);
+	sha512_add(&hash, data, len);
+	sha512_final(&hash, h);
+
+	memcpy(digest, h, CACHE_DIGEST_LEN);
+
+	burn(&hash, sizeof(hash));
+	burn(h, sizeof(h));
+}
+
+
+/*
+ * cache_set - returns the set of digest and locks it
+ */
+static struct set *
+cache_set(struct ed25519_cache *cache, const uint8_t digest[CACHE_DIGEST_LEN])
+{
+	size_t idx;
+	int i;
+
+	idx = 0;
+	for (i = 0; i < (int)sizeof(size_t); i++)
+		idx = (idx << 8) | digest[i];
+	idx &= cache->mask;
+
+	pthread_mutex_lock(&cache->lock[idx % CACHE_LOCKS]);
+
+	return &cache->sets[idx];
+}
+
+
+/*
+ * cache_unlock - unlocks the set locked by cache_set
+ */
+static void
+cache_unlock(struct ed25519_cache *cache, const struct set *set)
+{
+	size_t idx = set - cache->sets;
+
+	pthread_mutex_unlock(&cache->lock[idx % CACHE_LOCKS]);
+}
+
+
+/*
+ * set_find - looks up digest in set and moves it to the front.
+ *
+ * returns the entry or NULL if digest is not in the set.
+ */
+static struct entry *
+set_find(struct set *set, const uint8_t digest[CACHE_DIGEST_LEN])
+{
+	struct entry e;
+	int i;
+
+	for (i = 0; i < CACHE_WAYS; i++) {
+		if (set->way[i].used &&
+		    memcmp(set->way[i].digest, digest, CACHE_DIGEST_LEN) == 0)
+			break;
+	}
+
+	if (i == CACHE_WAYS)
+		return NULL;
+
+	if (i > 0) {
+		memcpy(&e, &set->way[i], sizeof(struct entry));
+		memmove(&set->way[1], &set->way[0], i * sizeof(struct entry));
+		memcpy(&set->way[0], &e, sizeof(struct entry));
+	}
+
+	return &set->way[0];
+}
+
+
+/*
+ * cache_sets - number of sets of a cache of at least size results, a
+ * power of two.
+ */
+static size_t
+cache_sets(size_t size)
+{
+	size_t n;
+
+	for (n = 1; n * CACHE_WAYS < size; n <<= 1)
+		;
+
+	return n;
+}
+
+
+/*
+ * ed25519_cache_size - bytes of memory for a cache of at least size
+ * results.
+ */
+size_t
+ed25519_cache_size(size_t size)
+{
+	return SCRATCH_LEN(sizeof(struct ed25519_cache)) +
+		cache_sets(size) * sizeof(struct set);
+}
+
+
+/*
+ * ed25519_cache_init - set up a cache in the size bytes at mem, it holds
+ * as many results as fit. flags tells which results are cached, see
+ * ED25519_CACHE_VALID and ED25519_CACHE_INVALID.
+ *
+ * returns NULL on failure.
+ */
+struct ed25519_cache *
+ed25519_cache_init(void *mem, size_t size, unsigned int flags)
+{
+	struct ed25519_cache *cache;
+	uint8_t *p = (uint8_t *)mem;
+	size_t n;
+	int i;
+
+	if (size < ed25519_cache_size(1))
+		return NULL;
+
+	/* largest power of two of sets, which fits */
+	for (n = 1; ed25519_cache_size(2 * n * CACHE_WAYS) <= size; n <<= 1)
+		;
+
+	memset(mem, 0, ed25519_cache_size(n * CACHE_WAYS));
+
+	cache = scratch_take(&p, sizeof(struct ed25519_cache));
+	cache->sets = scratch_take(&p, n * sizeof(struct set));
+
+	if (random_get(cache->key, sizeof(cache->key)) != 0)
+		return NULL;
+
+	cache->mask = n - 1;
+	cache->flags = flags;
+
+	for (i = 0; i < CACHE_LOCKS; i++)
+		pthread_mutex_init(&cache->lock[i], NULL);
+
+	return cache;
+}
+
+
+/*
+ * ed25519_verify_cached - like ed25519_verify, but looks up the result in
+ * the cache first and stores it there afterwards.
+ */
+bool
+ed25519_verify_cached(struct ed25519_cache *cache,
+		      const uint8_t sig[ED25519_SIG_LEN],
+		      const uint8_t pub[ED25519_KEY_LEN],
+		      const uint8_t *data, size_t len)
+{
+	uint8_t digest[CACHE_DIGEST_LEN];
+	struct entry *e;
+	struct set *set;
+	bool ok = false;
+
+	cache_digest(digest, cache, sig, pub, data, len);
+
+	set = cache_set(cache, digest);
+	e = set_find(set, digest);
+	if (e != NULL)
+		ok = e->ok;
+	cache_unlock(cache, set);
+
+	if (e != NULL) {
+		COUNT(&cache->hits);
+		return ok;
+	}
+
+	COUNT(&cache->misses);
+
+	ok = ed25519_verify(sig, pub, data, len);
+	if (!(cache->flags & (ok ? ED25519_CACHE_VALID : ED25519_CACHE_INVALID)))
+		return ok;
+
+	/* insert as most recent entry, unless another thread was faster */
+	set = cache_set(cache, digest);
+	if (set_find(set, digest) == NULL) {
+		if (set->way[CACHE_WAYS-1].used)
+			COUNT(&cache->evictions);
+		COUNT(&cache->inserts);
+
+		memmove(&set->way[1], &set->way[0],
+			(CACHE_WAYS-1) * sizeof(struct entry));
+		memcpy(set->way[0].digest, digest, CACHE_DIGEST_LEN);
+		set->way[0].used = 1;
+		set->way[0].ok = ok;
+	}
+	cache_unlock(cache, set);
+
+	return ok;
+}
+
+
+/*
+ * ed25519_cache_stats - get the counters of the cache
+ */
+void
+ed25519_cache_stats(struct ed25519_cache *cache,
+		    struct ed25519_cache_stats *stats)
+{
+	stats->hits = __atomic_load_n(&cache->hits, __ATOMIC_RELAXED);
+	stats->misses = __atomic_load_n(&cache->misses, __ATOMIC_RELAXED);
+	stats->inserts = __atomic_load_n(&cache->inserts, __ATOMIC_RELAXED);
+	stats->evictions = __atomic_load_n(&cache->evictions, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * ed25519_cache_destroy - release the cache, it must not be in use
+ * anymore. its memory may be reused afterwards.
+ */
+void
+ed25519_cache_destroy(struct ed25519_cache *cache)
+{
+	int i;
+
+	if (cache == NULL)
+		return;
+
+	for (i = 0; i < CACHE_LOCKS; i++)
+		pthread_mutex_destroy(&cache->lock[i]);
+
+	burn(cache->key, sizeof(cache->key));
+}
@@ -0,0 +1,407 @@
+/*
+ * asynchronous ed25519 verification queue.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * Submitted signatures are copied into a bounded ring. Worker threads
+ * take them out in batches for ed25519_verify_batch and report every
+ * result through the callback of its submitter.
+ *
+ * A worker waits until either max_batch signatures are queued or the
+ * oldest one has waited max_wait microseconds, so under load the batches
+ * are full and a lonely signature is delayed at most by max_wait.
+ *
+ * The queue lives in memory of the caller: the queue itself, the ring,
+ * the workers and then the batch and the scratch memory of every worker
+ * for ed25519_verify_batch_scratch.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "eddsa.h"
+
+#include "scratch.h"
+
+
+struct item {
+	uint8_t		sig[ED25519_SIG_LEN];
+	uint8_t		pub[ED25519_KEY_LEN];
+	const uint8_t	*msg;
+	size_t		len;
+
+	ed25519_queue_cb cb;
+	void		*user;
+
+	uint64_t	time;		/* of submission in ns */
+};
+
+/* private batch of a worker thread */
+struct worker {
+	struct ed25519_queue *queue;
+	pthread_t	thread;
+
+	struct item	*items;
+	const uint8_t	**sig;
+	const uint8_t	**pub;
+	const uint8_t	**msg;
+	size_t		*len;
+	bool		*valid;
+
+	struct eddsa_scratch scratch;
+};
+
+struct ed25519_queue {
+	struct item	*ring;
+	size_t		mask;		/* number of slots - 1 */
+	size_t		size;		/* max. number of queued items */
+	size_t		head;		/* next slot to fill */
+	size_t		count;		/* number of queued items */
+
+	size_t		max_batch;
+	uint64_t	max_wait;	/* in ns */
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	wakeup;
+	int		stop;
+
+	int		nthreads;	/* running workers */
+	struct worker	*workers;
+
+	struct ed25519_queue_stats stats;
+};
+
+
+/*
+ * now - monotonic time in ns
+ */
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/*
+ * queue_wait - let a worker wait until a batch is due or the queue is
+ * stopped. must be called with the lock held.
+ *
+ * returns the number of items to take, 0 if the worker should exit.
+ */
+static size_t
+queue_wait(struct ed25519_queue *q)
+{
+	struct timespec ts;
+	uint64_t deadline;
+
+	while (!q->stop && q->count < q->max_batch) {
+		if (q->count == 0) {
+			pthread_cond_wait(&q->wakeup, &q->lock);
+			continue;
+		}
+
+		/* the oldest item sets the deadline */
+		deadline = q->ring[(q->head - q->count) & q->mask].time +
+			q->max_wait;
+		if (now() >= deadline)
+			break;
+
+		ts.tv_sec = deadline / 1000000000;
+		ts.tv_nsec = deadline % 1000000000;
+		pthread_cond_timedwait(&q->wakeup, &q->lock, &ts);
+	}
+
+	return (q->count < q->max_batch) ? q->count : q->max_batch;
+}
+
+
+/*
+ * queue_worker - main loop of the worker threads
+ */
+static void *
+queue_worker(void *arg)
+{
+	struct worker *w = (struct worker *)arg;
+	struct ed25519_queue *q = w->queue;
+	struct item *it;
+	uint64_t t, lat, sum, max;
+	size_t n, i, tail;
+
+	pthread_mutex_lock(&q->lock);
+
+	while ((n = queue_wait(q)) > 0) {
+		/* take the n oldest items */
+		tail = q->head - q->count;
+		for (i = 0; i < n; i++)
+			memcpy(&w->items[i], &q->ring[(tail + i) & q->mask],
+			       sizeof(struct item));
+		q->count -= n;
+
+		/* there may be enough left for another worker */
+		if (q->count > 0)
+			pthread_cond_signal(&q->wakeup);
+
+		pthread_mutex_unlock(&q->lock);
+
+		for (i = 0; i < n; i++) {
+			w->sig[i] = w->items[i].sig;
+			w->pub[i] = w->items[i].pub;
+			w->msg[i] = w->items[i].msg;
+			w->len[i] = w->items[i].len;
+		}
+
+		ed25519_verify_batch_scratch(&w->scratch, n, w->valid, w->sig,
+					     w->pub, w->msg, w->len);
+
+		sum = max = 0;
+		t = now();
+		for (i = 0; i < n; i++) {
+			it = &w->items[i];
+			it->cb(it->user, w->valid[i]);
+
+			lat = (t - it->time) / 1000;
+			sum += lat;
+			if (lat > max)
+				max = lat;
+		}
+
+		pthread_mutex_lock(&q->lock);
+
+		q->stats.completed += n;
+		q->stats.batches++;
+		q->stats.latency_sum_us += sum;
+		if (max > q->stats.latency_max_us)
+			q->stats.latency_max_us = max;
+	}
+
+	pthread_mutex_unlock(&q->lock);
+
+	return NULL;
+}
+
+
+/*
+ * queue_slots - number of slots of a queue holding size signatures, a
+ * power of two.
+ */
+static size_t
+queue_slots(size_t size)
+{
+	size_t n;
+
+	for (n = 2; n < size; n <<= 1)
+		;
+
+	return n;
+}
+
+
+/*
+ * worker_size - bytes of the batch and scratch memory of a worker
+ */
+static size_t
+worker_size(size_t max_batch)
+{
+	return SCRATCH_LEN(max_batch * sizeof(struct item)) +
+		3 * SCRATCH_LEN(max_batch * sizeof(uint8_t *)) +
+		SCRATCH_LEN(max_batch * sizeof(size_t)) +
+		SCRATCH_LEN(max_batch * sizeof(bool)) +
+		ed25519_verify_batch_scratch_size(max_batch);
+}
+
+
+/*
+ * ed25519_queue_size - bytes of memory for a queue with the given
+ * parameters, see ed25519_queue_init.
+ */
+size_t
+ed25519_queue_size(size_t size, int threads, size_t max_batch)
+{
+	if (threads < 1)
+		threads = 1;
+	if (max_batch < 1)
+		max_batch = 1;
+
+	return SCRATCH_LEN(sizeof(struct ed25519_queue)) +
+		SCRATCH_LEN(queue_slots(size) * sizeof(struct item)) +
+		SCRATCH_LEN(threads * sizeof(struct worker)) +
+		threads * worker_size(max_batch);
+}
+
+
+/*
+ * ed25519_queue_init - set up a queue in the size bytes at mem, which
+ * holds up to qsize signatures. they are verified by the given number
+ * of threads in batches of up to max_batch signatures. a signature
+ * waits at most max_wait microseconds for its batch to fill up.
+ *
+ * returns NULL on failure, e.g. if size is less than ed25519_queue_size.
+ */
+struct ed25519_queue *
+ed25519_queue_init(void *mem, size_t size, size_t qsize, int threads,
+		   size_t max_batch, unsigned long max_wait)
+{
+	struct ed25519_queue *q;
+	pthread_condattr_t attr;
+	struct worker *w;
+	uint8_t *p = (uint8_t *)mem;
+	size_t n;
+	int i;
+
+	if (qsize < 1)
+		qsize = 1;
+	if (threads < 1)
+		threads = 1;
+	if (max_batch < 1)
+		max_batch = 1;
+
+	if (size < ed25519_queue_size(qsize, threads, max_batch))
+		return NULL;
+
+	n = queue_slots(qsize);
+
+	memset(mem, 0, ed25519_queue_size(qsize, threads, max_batch));
+
+	q = scratch_take(&p, sizeof(struct ed25519_queue));
+	q->ring = scratch_take(&p, n * sizeof(struct item));
+	q->workers = scratch_take(&p, threads * sizeof(struct worker));
+
+	for (i = 0; i < threads; i++) {
+		w = &q->workers[i];
+		w->queue = q;
+		w->items = scratch_take(&p, max_batch * sizeof(struct item));
+		w->sig = scratch_take(&p, max_batch * sizeof(uint8_t *));
+		w->pub = scratch_take(&p, max_batch * sizeof(uint8_t *));
+		w->msg = scratch_take(&p, max_batch * sizeof(uint8_t *));
+		w->len = scratch_take(&p, max_batch * sizeof(size_t));
+		w->valid = scratch_take(&p, max_batch * sizeof(bool));
+
+		w->scratch.size = ed25519_verify_batch_scratch_size(max_batch);
+		w->scratch.mem = scratch_take(&p, w->scratch.size);
+	}
+
+	q->mask = n - 1;
+	q->size = qsize;
+	q->max_batch = max_batch;
+	q->max_wait = (uint64_t)max_wait * 1000;
+
+	pthread_mutex_init(&q->lock, NULL);
+
+	/* deadlines are on the monotonic clock */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&q->wakeup, &attr);
+	pthread_condattr_destroy(&attr);
+
+	for (q->nthreads = 0; q->nthreads < threads; q->nthreads++) {
+		if (pthread_create(&q->workers[q->nthreads].thread, NULL,
+				   queue_worker, &q->workers[q->nthreads]) != 0)
+			break;
+	}
+
+	if (q->nthreads == 0) {
+		ed25519_queue_destroy(q);
+		return NULL;
+	}
+
+	return q;
+}
+
+
+/*
+ * ed25519_queue_submit - queue the verification of sig, cb(user, result)
+ * is called from one of the worker threads when it is done. msg must
+ * stay valid until then, sig and pub are copied.
+ *
+ * returns false if the queue is full.
+ */
+bool
+ed25519_queue_submit(struct ed25519_queue *q,
+		     const uint8_t sig[ED25519_SIG_LEN],
+		     const uint8_t pub[ED25519_KEY_LEN],
+		     const uint8_t *msg, size_t len,
+		     ed25519_queue_cb cb, void *user)
+{
+	struct item *it;
+
+	pthread_mutex_lock(&q->lock);
+
+	if (q->count >= q->size) {
+		q->stats.rejected++;
+		pthread_mutex_unlock(&q->lock);
+		return false;
+	}
+
+	it = &q->ring[q->head & q->mask];
+	memcpy(it->sig, sig, ED25519_SIG_LEN);
+	memcpy(it->pub, pub, ED25519_KEY_LEN);
+	it->msg = msg;
+	it->len = len;
+	it->cb = cb;
+	it->user = user;
+	it->time = now();
+
+	q->head++;
+	q->count++;
+
+	q->stats.submitted++;
+	if (q->count > q->stats.max_depth)
+		q->stats.max_depth = q->count;
+
+	/* a new deadline starts or a batch is full */
+	if (q->count == 1 || q->count % q->max_batch == 0)
+		pthread_cond_signal(&q->wakeup);
+
+	pthread_mutex_unlock(&q->lock);
+
+	return true;
+}
+
+
+/*
+ * ed25519_queue_stats - get the counters of the queue
+ */
+void
+ed25519_queue_stats(struct ed25519_queue *q, struct ed25519_queue_stats *stats)
+{
+	pthread_mutex_lock(&q->lock);
+	memcpy(stats, &q->stats, sizeof(struct ed25519_queue_stats));
+	stats->depth = q->count;
+	pthread_mutex_unlock(&q->lock);
+}
+
+
+/*
+ * ed25519_queue_destroy - verify all queued signatures, then stop the
+ * worker threads. the memory of the queue may be reused afterwards.
+ */
+void
+ed25519_queue_destroy(struct ed25519_queue *q)
+{
+	int i;
+
+	if (q == NULL)
+		return;
+
+	pthread_mutex_lock(&q->lock);
+	q->stop = 1;
+	pthread_cond_broadcast(&q->wakeup);
+	pthread_mutex_unlock(&q->lock);
+
+	for (i = 0; i < q->nthreads; i++)
+		pthread_join(q->workers[i].thread, NULL);
+
+	pthread_cond_destroy(&q->wakeup);
+	pthread_mutex_destroy(&q->lock);
+}
@@ -9,35 +9,135 @@
  * References:
  * [1] High-speed high-security signatures, 2011/09/26,
  *     Bernstein, Duif, Lange, Schwabe, Yang
- *
- * TODO:
- *   - batch verify
  */
 
+#include <limits.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 #include "eddsa.h"
 
 #include "sha512.h"
 #include "sc.h"
 #include "fld.h"
 #include "ed.h"
+#include "burn.h"
 #include "burnstack.h"
+#include "scratch.h"
+
+
+/*
+ * windows has no struct iovec, we only use it internally there.
+ */
+#ifdef _WIN32
+struct iovec {
+	void	*iov_base;
+	size_t	iov_len;
+};
+#endif
+
+
+/*
+ * external sha512 provider, NULL for the builtin sha512
+ */
+static struct ed25519_sha512_provider ext_provider;
+static const struct ed25519_sha512_provider *ext_sha512 = NULL;
+
+
+/*
+ * hash context for either the builtin sha512 or the external provider
+ */
+struct hash {
+	const struct ed25519_sha512_provider *ext;
+	union {
+		struct sha512	sha;
+		uint64_t	ext[ED25519_SHA512_CTX_MAX / 8];
+	} u;
+};
+
+
+static INLINE void
+hash_init(struct hash *h)
+{
+	h->ext = ext_sha512;
+	if (h->ext)
+		h->ext->init(h->u.ext);
+	else
+		sha512_init(&h->u.sha);
+}
+
+static INLINE void
+hash_add(struct hash *h, const uint8_t *data, size_t len)
+{
+	if (h->ext)
+		h->ext->update(h->u.ext, data, len);
+	else
+		sha512_add(&h->u.sha, data, len);
+}
+
+static INLINE void
+hash_final(struct hash *h, uint8_t out[SHA512_HASH_LENGTH])
+{
+	if (h->ext)
+		h->ext->final(h->u.ext, out);
+	else
+		sha512_final(&h->u.sha, out);
+}
+
+
+/*
+ * hash_addv - adds the iovcnt buffers of iov to h.
+ */
+static void
+hash_addv(struct hash *h, const struct iovec *iov, int iovcnt)
+{
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		hash_add(h, (const uint8_t *)iov[i].iov_base, iov[i].iov_len);
+}
+
+
+/*
+ * ed25519_set_sha512 - use the given sha512 provider for all ed25519
+ * operations, or the builtin sha512 if p is NULL.
+ */
+bool
+ed25519_set_sha512(const struct ed25519_sha512_provider *p)
+{
+	if (p == NULL) {
+		ext_sha512 = NULL;
+		return true;
+	}
+
+	if (p->init == NULL || p->update == NULL || p->final == NULL ||
+	    p->ctx_size > ED25519_SHA512_CTX_MAX)
+		return false;
+
+	ext_provider = *p;
+	ext_sha512 = &ext_provider;
+
+	return true;
+}
 
 
 static void
 ed25519_key_setup(uint8_t out[SHA512_HASH_LENGTH],
 		  const uint8_t sk[ED25519_KEY_LEN])
 {
-	struct sha512 hash;
+	struct hash hash;
 
 	/* hash secret-key */
-	sha512_init(&hash);
-	sha512_add(&hash, sk, ED25519_KEY_LEN);
-	sha512_final(&hash, out);
+	hash_init(&hash);
+	hash_add(&hash, sk, ED25519_KEY_LEN);
+	hash_final(&hash, out);
+	burnlocal(hash);
 
 	/* delete bit 255 and set bit 254 */
 	out[31] &= 0x7f;
@@ -64,6 +164,9 @@ genpub(uint8_t pub[ED25519_KEY_LEN], const uint8_t sec[ED25519_KEY_LEN])
 	/* multiply with base point to calculate public key */
 	ed_scale_base(&A, a);
 	ed_export(pub, &A);
+
+	burnlocal(h);
+	burnlocal(a);
 }
 
 
@@ -79,15 +182,16 @@ ed25519_genpub(uint8_t pub[ED25519_KEY_LEN], const uint8_t sec[ED25519_KEY_LEN])
 
 
 /*
- * sign - create ed25519 signature of data using secret key sec
+ * sign - create ed25519 signature of the data in the iovcnt buffers of iov
+ * using secret key sec
  */
 static void
 sign(uint8_t sig[ED25519_SIG_LEN],
      const uint8_t sec[ED25519_KEY_LEN],
      const uint8_t pub[ED25519_KEY_LEN],
-     const uint8_t *data, size_t len)
+     const struct iovec *iov, int iovcnt)
 {
-	struct sha512 hash;
+	struct hash hash;
 	uint8_t h[SHA512_HASH_LENGTH];
 	
 	sc_t a, r, t, S;
@@ -98,10 +202,10 @@ sign(uint8_t sig[ED25519_SIG_LEN],
 	sc_import(a, h, 32);
 
 	/* hash next 32 bytes together with data to form r */
-	sha512_init(&hash);
-	sha512_add(&hash, h+32, 32);
-	sha512_add(&hash, data, len);
-	sha512_final(&hash, h);
+	hash_init(&hash);
+	hash_add(&hash, h+32, 32);
+	hash_addv(&hash, iov, iovcnt);
+	hash_final(&hash, h);
 	sc_import(r, h, sizeof(h));
 
 	/* calculate R = r * B which form the first 256bit of the signature */
@@ -109,17 +213,22 @@ sign(uint8_t sig[ED25519_SIG_LEN],
 	ed_export(sig, &R);
 	
 	/* calculate t := Hash(export(R), export(A), data) mod m */
-	sha512_init(&hash);
-	sha512_add(&hash, sig, 32);
-	sha512_add(&hash, pub, 32);
-	sha512_add(&hash, data, len);
-	sha512_final(&hash, h);
+	hash_init(&hash);
+	hash_add(&hash, sig, 32);
+	hash_add(&hash, pub, 32);
+	hash_addv(&hash, iov, iovcnt);
+	hash_final(&hash, h);
 	sc_import(t, h, sizeof(h));
 	
 	/* calculate S := r + t*a mod m and finish the signature */
 	sc_mul(S, t, a);
 	sc_add(S, r, S);
 	sc_export(sig+32, S);
+
+	burnlocal(hash);
+	burnlocal(h);
+	burnlocal(a);
+	burnlocal(r);
 }
 
 
@@ -132,26 +241,90 @@ ed25519_sign(uint8_t sig[ED25519_SIG_LEN],
 	   const uint8_t pub[ED25519_KEY_LEN],
 	   const uint8_t *data, size_t len)
 {
-	sign(sig, sec, pub, data, len);
-	burnstack(4096);
+	struct iovec iov;
+
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+
+	sign(sig, sec, pub, &iov, 1);
+	burnstack(3072);
 }
 
 
+#ifndef _WIN32
+
 /*
- * ed25519_verify - verifies an ed25519-signature of given data.
- *
- * note: this functions runs in vartime and does no stack cleanup, since
- * all information are considered public.
+ * ed25519_signv - like ed25519_sign, but signs the concatenation of the
+ * iovcnt buffers of iov.
+ */
+void
+ed25519_signv(uint8_t sig[ED25519_SIG_LEN],
+	      const uint8_t sec[ED25519_KEY_LEN],
+	      const uint8_t pub[ED25519_KEY_LEN],
+	      const struct iovec *iov, int iovcnt)
+{
+	sign(sig, sec, pub, iov, iovcnt);
+	burnstack(3072);
+}
+
+#endif
+
+
+/*
+ * verify_hash - calculates t := Hash(export(R), export(A), data) mod m
+ * for the data in the iovcnt buffers of iov.
+ */
+static void
+verify_hash(uint8_t t_out[ED25519_VERIFY_HASH_LEN],
+	    const uint8_t sig[ED25519_SIG_LEN],
+	    const uint8_t pub[ED25519_KEY_LEN],
+	    const struct iovec *iov, int iovcnt)
+{
+	struct hash hash;
+	uint8_t h[SHA512_HASH_LENGTH];
+	sc_t t;
+
+	hash_init(&hash);
+	hash_add(&hash, sig, 32);
+	hash_add(&hash, pub, 32);
+	hash_addv(&hash, iov, iovcnt);
+	hash_final(&hash, h);
+	sc_import(t, h, 64);
+	sc_export(t_out, t);
+}
+
+
+/*
+ * ed25519_verify_hash - first half of ed25519_verify, calculates
+ * t := Hash(export(R), export(A), data) mod m for the signature sig and
+ * exports it to t_out.
+ */
+void
+ed25519_verify_hash(uint8_t t_out[ED25519_VERIFY_HASH_LEN],
+		    const uint8_t sig[ED25519_SIG_LEN],
+		    const uint8_t pub[ED25519_KEY_LEN],
+		    const uint8_t *data, size_t len)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+
+	verify_hash(t_out, sig, pub, &iov, 1);
+}
+
+
+/*
+ * ed25519_verify_curve - second half of ed25519_verify, checks the
+ * signature sig with t from ed25519_verify_hash.
  *
  * returns true if signature is ok and false otherwise.
  */
 bool
-ed25519_verify(const uint8_t sig[ED25519_SIG_LEN],
-	       const uint8_t pub[ED25519_KEY_LEN],
-	       const uint8_t *data, size_t len)
+ed25519_verify_curve(const uint8_t sig[ED25519_SIG_LEN],
+		     const uint8_t pub[ED25519_KEY_LEN],
+		     const uint8_t t_in[ED25519_VERIFY_HASH_LEN])
 {
-	struct sha512 hash;
-	uint8_t h[SHA512_HASH_LENGTH];
 	struct ed A, C;
 	sc_t t, S;
 	uint8_t check[32];
@@ -159,72 +332,1030 @@ ed25519_verify(const uint8_t sig[ED25519_SIG_LEN],
 	/* import public key */
 	ed_import(&A, pub);
 
-	/* import S from second half of the signature */
+	/* import S from second half of the signature and t */
 	sc_import(S, sig+32, 32);
-
-	/* calculate t := Hash(export(R), export(A), data) mod m */
-	sha512_init(&hash);
-	sha512_add(&hash, sig, 32);
-	sha512_add(&hash, pub, 32);
-	sha512_add(&hash, data, len);
-	sha512_final(&hash, h);
-	sc_import(t, h, 64);
+	sc_import(t, t_in, 32);
 
 	/* verify signature (vartime!) */
 	fld_neg(A.x, A.x);
 	fld_neg(A.t, A.t);
 	ed_dual_scale(&C, S, t, &A);
-	ed_export(check, &C);
+	ed_export_vartime(check, &C);
 	
 	/* is export(C) == export(R) (vartime!) */
 	return (memcmp(check, sig, 32) == 0);
 }
 
 
+/*
+ * ed25519_verify - verifies an ed25519-signature of given data.
+ *
+ * note: this functions runs in vartime and does no stack cleanup, since
+ * all information are considered public.
+ *
+ * returns true if signature is ok and false otherwise.
+ */
+bool
+ed25519_verify(const uint8_t sig[ED25519_SIG_LEN],
+	       const uint8_t pub[ED25519_KEY_LEN],
+	       const uint8_t *data, size_t len)
+{
+	uint8_t t[ED25519_VERIFY_HASH_LEN];
+
+	ed25519_verify_hash(t, sig, pub, data, len);
+
+	return ed25519_verify_curve(sig, pub, t);
+}
+
+
+#ifndef _WIN32
+
+/*
+ * ed25519_verifyv - like ed25519_verify, but for the concatenation of
+ * the iovcnt buffers of iov.
+ */
+bool
+ed25519_verifyv(const uint8_t sig[ED25519_SIG_LEN],
+		const uint8_t pub[ED25519_KEY_LEN],
+		const struct iovec *iov, int iovcnt)
+{
+	uint8_t t[ED25519_VERIFY_HASH_LEN];
+
+	verify_hash(t, sig, pub, iov, iovcnt);
+
+	return ed25519_verify_curve(sig, pub, t);
+}
+
+#endif
+
+
+/*
+ * step-wise verification
+ *
+ * ed25519_verify_step splits ed25519_verify into units, whose costs are
+ * measured in ops of about the time of a point addition or doubling:
+ * hashing VERIFY_HASH_BYTES of the data, preparing the scalars and the
+ * public key (mostly the square root of its decompression), every point
+ * operation of ed_dual_step and the compression of the result.
+ */
+
+#define VERIFY_HASH_BYTES	SHA512_BLOCK_SIZE
+#define VERIFY_OPS_PREPARE	28
+#define VERIFY_OPS_EXPORT	6
+
+enum {
+	VERIFY_HASH,
+	VERIFY_PREPARE,
+	VERIFY_SCALE,
+	VERIFY_EXPORT,
+	VERIFY_DONE
+};
+
+/*
+ * internal layout of struct ed25519_verify_ctx
+ */
+struct verify_ctx {
+	const uint8_t	*data;		/* rest of the data to hash */
+	size_t		len;
+
+	uint8_t		sig[ED25519_SIG_LEN];
+	uint8_t		pub[ED25519_KEY_LEN];
+	sc_t		t;
+
+	int		state;
+	int		ok;
+
+	union {
+		struct hash	hash;
+		struct ed_dual	dual;
+	} u;
+};
+
+/* make sure struct verify_ctx fits into struct ed25519_verify_ctx */
+typedef char verify_ctx_size_check[
+	(sizeof(struct verify_ctx) <= sizeof(struct ed25519_verify_ctx)) ? 1 : -1];
+
+
+/*
+ * ed25519_verify_start - prepares ctx for the step-wise verification of
+ * sig with ed25519_verify_step. data must stay valid until the
+ * verification is finished.
+ */
+void
+ed25519_verify_start(struct ed25519_verify_ctx *vctx,
+		     const uint8_t sig[ED25519_SIG_LEN],
+		     const uint8_t pub[ED25519_KEY_LEN],
+		     const uint8_t *data, size_t len)
+{
+	struct verify_ctx *ctx = (struct verify_ctx *)vctx;
+
+	memcpy(ctx->sig, sig, ED25519_SIG_LEN);
+	memcpy(ctx->pub, pub, ED25519_KEY_LEN);
+	ctx->data = data;
+	ctx->len = len;
+
+	ctx->state = VERIFY_HASH;
+	ctx->ok = 0;
+
+	hash_init(&ctx->u.hash);
+	hash_add(&ctx->u.hash, sig, 32);
+	hash_add(&ctx->u.hash, pub, 32);
+}
+
+
+/*
+ * ed25519_verify_step - continues the verification of ctx with units
+ * costing at most ops in total. a unit which costs more than ops is only
+ * done if it is the first of the step, so every step makes progress.
+ *
+ * returns -1 if the verification is not finished yet, otherwise 1 if the
+ * signature is ok and 0 if not.
+ */
+int
+ed25519_verify_step(struct ed25519_verify_ctx *vctx, unsigned int ops_max)
+{
+	struct verify_ctx *ctx = (struct verify_ctx *)vctx;
+	uint8_t h[SHA512_HASH_LENGTH];
+	uint8_t check[32];
+	struct ed A;
+	sc_t S;
+	size_t n;
+	int ops, first;
+
+#define AFFORD(cost)	((cost) <= ops || first)
+
+	ops = (ops_max < INT_MAX) ? (int)ops_max : INT_MAX;
+
+	for (first = 1; ; first = 0) {
+		switch (ctx->state) {
+		case VERIFY_HASH:
+			if (!AFFORD(1))
+				return -1;
+
+			if (ctx->len > 0) {
+				n = (ctx->len < VERIFY_HASH_BYTES) ?
+					ctx->len : VERIFY_HASH_BYTES;
+				hash_add(&ctx->u.hash, ctx->data, n);
+				ctx->data += n;
+				ctx->len -= n;
+			} else {
+				hash_final(&ctx->u.hash, h);
+				sc_import(ctx->t, h, 64);
+				ctx->state = VERIFY_PREPARE;
+			}
+			ops--;
+			break;
+
+		case VERIFY_PREPARE:
+			if (!AFFORD(VERIFY_OPS_PREPARE))
+				return -1;
+
+			/* like ed25519_verify_curve */
+			ed_import(&A, ctx->pub);
+			fld_neg(A.x, A.x);
+			fld_neg(A.t, A.t);
+			sc_import(S, ctx->sig+32, 32);
+
+			ed_dual_start(&ctx->u.dual, S, ctx->t, &A);
+			ctx->state = VERIFY_SCALE;
+			ops -= VERIFY_OPS_PREPARE;
+			break;
+
+		case VERIFY_SCALE:
+			if (!AFFORD(1))
+				return -1;
+
+			ops = ed_dual_step(&ctx->u.dual, (ops > 0) ? ops : 1);
+			if (ctx->u.dual.i >= 0)
+				return -1;
+			ctx->state = VERIFY_EXPORT;
+			break;
+
+		case VERIFY_EXPORT:
+			if (!AFFORD(VERIFY_OPS_EXPORT))
+				return -1;
+
+			ed_export_vartime(check, &ctx->u.dual.R);
+			ctx->ok = (memcmp(check, ctx->sig, 32) == 0);
+			ctx->state = VERIFY_DONE;
+			ops -= VERIFY_OPS_EXPORT;
+			break;
+
+		default:
+			return ctx->ok;
+		}
+	}
+
+#undef AFFORD
+}
+
+
+/*
+ * hot keys
+ *
+ * For a public key A which verifies a lot of signatures we set up the
+ * table of ed_hot_init for -A. ed25519_verify_hotkey then calculates
+ * S*B - t*A with two table based scalings, instead of the doublings of
+ * ed_dual_scale. The window w of the table is the largest one which fits
+ * into the memory budget of the caller.
+ */
+
+/*
+ * larger windows need fewer additions, but the tables beyond w = 9 (about
+ * 870KB) don't fit the level 2 cache anymore and were slower.
+ */
+#define HOTKEY_WMIN	4
+#define HOTKEY_WMAX	9
+
+struct ed25519_hotkey {
+	uint8_t		pub[ED25519_KEY_LEN];
+	int		w;
+	struct pced	table[];
+};
+
+
+/*
+ * hotkey_size - memory needed for a hot key with window w
+ */
+static size_t
+hotkey_size(int w)
+{
+	return offsetof(struct ed25519_hotkey, table) +
+		(size_t)ED_HOT_ENTRIES(w) * sizeof(struct pced);
+}
+
+
+/*
+ * hotkey_window - returns the largest window whose hot key fits into
+ * budget bytes or 0 if there is none.
+ */
+static int
+hotkey_window(size_t budget)
+{
+	int w;
+
+	for (w = HOTKEY_WMAX; w >= HOTKEY_WMIN; w--) {
+		if (hotkey_size(w) <= budget)
+			return w;
+	}
+
+	return 0;
+}
+
+
+/*
+ * ed25519_hotkey_size - returns the memory a hot key takes with the
+ * largest table fitting into budget bytes, or 0 if budget is too small.
+ */
+size_t
+ed25519_hotkey_size(size_t budget)
+{
+	int w = hotkey_window(budget);
+
+	return (w > 0) ? hotkey_size(w) : 0;
+}
+
+
+/*
+ * ed25519_hotkey_init - sets up a hot key for pub in the size bytes at
+ * mem, which must be aligned for uint64_t.
+ *
+ * returns the hot key or NULL if size is too small.
+ */
+struct ed25519_hotkey *
+ed25519_hotkey_init(void *mem, size_t size,
+		    const uint8_t pub[ED25519_KEY_LEN])
+{
+	struct ed25519_hotkey *key = (struct ed25519_hotkey *)mem;
+	struct ed A;
+	int w;
+
+	w = hotkey_window(size);
+	if (w == 0 || ((uintptr_t)mem & 7) != 0)
+		return NULL;
+
+	memcpy(key->pub, pub, ED25519_KEY_LEN);
+	key->w = w;
+
+	/* the table holds the multiples of -A */
+	ed_import(&A, pub);
+	fld_neg(A.x, A.x);
+	fld_neg(A.t, A.t);
+	ed_hot_init(key->table, w, &A);
+
+	return key;
+}
+
+
+/*
+ * ed25519_verify_hotkey - like ed25519_verify for the public key of the
+ * hot key.
+ *
+ * returns true if signature is ok and false otherwise.
+ */
+bool
+ed25519_verify_hotkey(const uint8_t sig[ED25519_SIG_LEN],
+		      const struct ed25519_hotkey *key,
+		      const uint8_t *data, size_t len)
+{
+	uint8_t t_in[ED25519_VERIFY_HASH_LEN];
+	uint8_t check[32];
+	struct ed C;
+	sc_t t, S;
+
+	ed25519_verify_hash(t_in, sig, key->pub, data, len);
+
+	sc_import(S, sig+32, 32);
+	sc_import(t, t_in, 32);
+
+	/* C <- S*B - t*A (vartime!) */
+	ed_dual_scale_hot(&C, S, t, key->table, key->w);
+	ed_export_vartime(check, &C);
+
+	return (memcmp(check, sig, 32) == 0);
+}
+
+
+/*
+ * batch verification
+ *
+ * A batch of signatures (R_i, S_i) on public keys A_i with hashes t_i is
+ * checked with the cofactored equation
+ *
+ *	8 * (sum z_i*R_i + sum_k (sum_{A_i = A_k} z_i*t_i) * A_k
+ *		- (sum z_i*S_i) * B) = 0,
+ *
+ * where the z_i are 128bit random numbers. Signatures from the same
+ * public key share one A_k, so a batch from a single signer costs about
+ * one multiplication of R_i per signature. The z_i are derived from a
+ * hash over the whole batch, which makes the result deterministic and
+ * doesn't need a random source.
+ *
+ * The batch is processed in chunks of VERIFY_BATCH signatures on the
+ * stack, or with ed25519_verify_batch_scratch in chunks of up to
+ * VERIFY_BATCH_MAX signatures in the memory of the caller. If a chunk
+ * fails, its signatures are verified one by one (in pairs with
+ * verify_curve2) to find the bad ones.
+ *
+ * The batch accepts the signature (R, S) of the public key A exactly if
+ *
+ *	R and A are canonical encodings of points on the curve,
+ *	S < m and
+ *	8*S*B = 8*R + 8*t*A.
+ *
+ * The one by one checks follow the same rule, so the verdict on a
+ * signature doesn't depend on its place in the batch. It can differ
+ * from ed25519_verify though, which checks S*B = R + t*A without the
+ * cofactor and doesn't reject S >= m or non-canonical encodings.
+ */
+
+/*
+ * the chunks on the stack are small, so that ed25519_verify_batch fits
+ * into a stack of 16K. they take about twice the time per signature of
+ * the larger chunks of ed25519_verify_batch_scratch.
+ */
+#define VERIFY_BATCH	4
+
+/*
+ * larger chunks save a few doublings per signature only, but the search
+ * for the distinct keys grows quadratically and a bad signature costs
+ * the check of more good ones.
+ */
+#define VERIFY_BATCH_MAX	64
+
+/*
+ * smaller chunks are verified directly, for two signatures from distinct
+ * keys the batch equation is about as fast as verify_curve2.
+ */
+#define VERIFY_BATCH_MIN	2
+
+
+/*
+ * temporaries of a chunk of n signatures, see batch_setup.
+ */
+struct batch {
+	uint8_t		(*t)[ED25519_VERIFY_HASH_LEN];
+
+	/* for batch_check, with 2n+1 points */
+	sc_t		*z;
+	int		*key;
+	sc_t		*x;
+	struct ed	*P;
+	struct ed_multi	*multi;
+
+	/* for batch_hash, these share the memory of multi */
+	struct sha512	*ctx;
+	const struct sha512 **pctx;
+	uint8_t		(*h)[SHA512_HASH_LENGTH];
+};
+
+#define BATCH_LEN(n)						\
+	(SCRATCH_LEN((n) * ED25519_VERIFY_HASH_LEN) +		\
+	 SCRATCH_LEN((n) * sizeof(sc_t)) +			\
+	 SCRATCH_LEN((n) * sizeof(int)) +			\
+	 SCRATCH_LEN((2*(n) + 1) * sizeof(sc_t)) +		\
+	 SCRATCH_LEN((2*(n) + 1) * sizeof(struct ed)) +	\
+	 SCRATCH_LEN((2*(n) + 1) * sizeof(struct ed_multi)))
+
+
+/* p = 2^255 - 19 and the group order m, little endian */
+static const uint8_t con_p[32] = {
+	0xed, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f };
+
+static const uint8_t con_m[32] = {
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+	0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 };
+
+
+/*
+ * less - checks if the little endian number a, without the bits of mask
+ * in its last byte, is less than b. (vartime)
+ */
+static bool
+less(const uint8_t a[32], const uint8_t b[32], uint8_t mask)
+{
+	uint8_t x;
+	int i;
+
+	for (i = 31; i >= 0; i--) {
+		x = (i == 31) ? (a[i] & ~mask) : a[i];
+		if (x != b[i])
+			return x < b[i];
+	}
+
+	return false;
+}
+
+
+/*
+ * import_point - imports P from in, which must be the canonical encoding
+ * of a point on the curve: y < p and no sign for x = 0 (RFC 8032, 5.1.3).
+ *
+ * returns false if it is not.
+ */
+static bool
+import_point(struct ed *P, const uint8_t in[32])
+{
+	fld_t zero;
+
+	if (!less(in, con_p, 0x80))
+		return false;
+
+	ed_import(P, in);
+	if (!ed_on_curve(P))
+		return false;
+
+	fld_set0(zero, 0);
+	return !((in[31] & 0x80) && fld_eq(P->x, zero));
+}
+
+
+/*
+ * verify_import - imports -A, R and S of the signature sig for the
+ * acceptance rule of the batch.
+ *
+ * returns false if one of them is not valid.
+ */
+static bool
+verify_import(struct ed *A, struct ed *R, sc_t S,
+	      const uint8_t sig[ED25519_SIG_LEN],
+	      const uint8_t pub[ED25519_KEY_LEN])
+{
+	if (!less(sig+32, con_m, 0) || !import_point(A, pub) ||
+	    !import_point(R, sig))
+		return false;
+
+	fld_neg(A->x, A->x);
+	fld_neg(A->t, A->t);
+	sc_import(S, sig+32, 32);
+
+	return true;
+}
+
+
+/*
+ * verify_strict - like ed25519_verify_curve, but with the acceptance
+ * rule of the batch.
+ */
+static bool
+verify_strict(const uint8_t sig[ED25519_SIG_LEN],
+	      const uint8_t pub[ED25519_KEY_LEN],
+	      const uint8_t t_in[ED25519_VERIFY_HASH_LEN])
+{
+	struct ed A, R, C;
+	sc_t t, S;
+
+	if (!verify_import(&A, &R, S, sig, pub))
+		return false;
+
+	sc_import(t, t_in, 32);
+
+	/* C <- S*B - t*A, is 8*C == 8*R (vartime!) */
+	ed_dual_scale(&C, S, t, &A);
+
+	return ed_cofactor_eq(&C, &R);
+}
+
+
+/*
+ * batch_setup - lay out the temporaries for chunks of n signatures in
+ * mem, which holds at least BATCH_LEN(n) bytes.
+ */
+static void
+batch_setup(struct batch *b, void *mem, int n)
+{
+	uint8_t *p = (uint8_t *)mem;
+
+	b->t = scratch_take(&p, n * ED25519_VERIFY_HASH_LEN);
+	b->z = scratch_take(&p, n * sizeof(sc_t));
+	b->key = scratch_take(&p, n * sizeof(int));
+	b->x = scratch_take(&p, (2*n + 1) * sizeof(sc_t));
+	b->P = scratch_take(&p, (2*n + 1) * sizeof(struct ed));
+	b->multi = scratch_take(&p, (2*n + 1) * sizeof(struct ed_multi));
+
+	/* the hashes are done before the multiples are needed */
+	p = (uint8_t *)b->multi;
+	b->ctx = scratch_take(&p, n * sizeof(struct sha512));
+	b->pctx = scratch_take(&p, n * sizeof(struct sha512 *));
+	b->h = scratch_take(&p, n * SHA512_HASH_LENGTH);
+}
+
+
+/*
+ * batch_hash - calculates t_i := Hash(export(R), export(A), msg) mod m
+ * for n signatures into b->t, with sha512_multi if possible.
+ */
+static void
+batch_hash(struct batch *b, int n, const uint8_t *sig[],
+	   const uint8_t *pub[], const uint8_t *msg[], const size_t len[])
+{
+	struct iovec iov;
+	sc_t tmp;
+	int i;
+
+	if (ext_sha512) {
+		for (i = 0; i < n; i++) {
+			iov.iov_base = (void *)msg[i];
+			iov.iov_len = len[i];
+			verify_hash(b->t[i], sig[i], pub[i], &iov, 1);
+		}
+		return;
+	}
+
+	/* R and A only go into the buffer of the contexts */
+	for (i = 0; i < n; i++) {
+		sha512_init(&b->ctx[i]);
+		sha512_add(&b->ctx[i], sig[i], 32);
+		sha512_add(&b->ctx[i], pub[i], 32);
+		b->pctx[i] = &b->ctx[i];
+	}
+
+	sha512_multi(n, &b->h[0][0], b->pctx, msg, len);
+
+	for (i = 0; i < n; i++) {
+		sc_import(tmp, b->h[i], SHA512_HASH_LENGTH);
+		sc_export(b->t[i], tmp);
+	}
+}
+
+
+/*
+ * batch_weights - derives the 128bit weights z_i from a hash over the
+ * n signatures, public keys and hashes t_i.
+ */
+static void
+batch_weights(int n, sc_t z[], uint8_t t[][ED25519_VERIFY_HASH_LEN],
+	      const uint8_t *sig[], const uint8_t *pub[])
+{
+	struct sha512 hash;
+	uint8_t seed[SHA512_HASH_LENGTH], h[SHA512_HASH_LENGTH];
+	uint8_t cnt;
+	int i;
+
+	sha512_init(&hash);
+	for (i = 0; i < n; i++) {
+		sha512_add(&hash, sig[i], ED25519_SIG_LEN);
+		sha512_add(&hash, pub[i], ED25519_KEY_LEN);
+		sha512_add(&hash, t[i], ED25519_VERIFY_HASH_LEN);
+	}
+	sha512_final(&hash, seed);
+
+	/* every further hash gives four weights */
+	for (i = 0; i < n; i++) {
+		if ((i & 3) == 0) {
+			cnt = i >> 2;
+			sha512_init(&hash);
+			sha512_add(&hash, seed, sizeof(seed));
+			sha512_add(&hash, &cnt, 1);
+			sha512_final(&hash, h);
+		}
+
+		/* z_i must not be zero */
+		h[16 * (i & 3)] |= 1;
+		sc_import(z[i], h + 16 * (i & 3), 16);
+	}
+}
+
+
+/*
+ * batch_check - checks the batch equation for n signatures with the
+ * hashes t_i from batch_hash.
+ *
+ * returns true if it holds and all signatures and public keys are valid
+ * as of the acceptance rule.
+ */
+static bool
+batch_check(struct batch *b, int n, const uint8_t *sig[], const uint8_t *pub[])
+{
+	uint8_t (*t)[ED25519_VERIFY_HASH_LEN] = b->t;
+	struct ed *P = b->P, C;
+	sc_t *x = b->x, *z = b->z, tmp;
+	int *key = b->key;
+	int i, j, k, nkeys;
+
+	batch_weights(n, z, t, sig, pub);
+
+	/* P[0] <- -B with scalar sum z_i*S_i */
+	ed_base(&P[0]);
+	fld_neg(P[0].x, P[0].x);
+	fld_neg(P[0].t, P[0].t);
+	memset(x[0], 0, sizeof(sc_t));
+
+	/* P[1..n] <- R_i with scalar z_i */
+	for (i = 0; i < n; i++) {
+		if (!less(sig[i]+32, con_m, 0) || !import_point(&P[1+i], sig[i]))
+			return false;
+
+		memcpy(x[1+i], z[i], sizeof(sc_t));
+
+		sc_import(tmp, sig[i] + 32, 32);
+		sc_mul(tmp, tmp, z[i]);
+		sc_add(x[0], x[0], tmp);
+		sc_reduce(x[0], x[0]);
+	}
+
+	/*
+	 * the distinct public keys A_k follow, each with the sum of
+	 * z_i*t_i over its signatures.
+	 */
+	nkeys = 0;
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < nkeys; k++) {
+			if (memcmp(pub[key[k]], pub[i], ED25519_KEY_LEN) == 0)
+				break;
+		}
+
+		j = 1 + n + k;
+		if (k == nkeys) {
+			key[nkeys++] = i;
+
+			if (!import_point(&P[j], pub[i]))
+				return false;
+			memset(x[j], 0, sizeof(sc_t));
+		}
+
+		sc_import(tmp, t[i], ED25519_VERIFY_HASH_LEN);
+		sc_mul(tmp, tmp, z[i]);
+		sc_add(x[j], x[j], tmp);
+		sc_reduce(x[j], x[j]);
+	}
+
+	ed_multi_scale(&C, 1 + n + nkeys, (const sc_t *)x, P, b->multi);
+	ed_clear_cofactor(&C, &C);
+
+	return ed_is_neutral(&C);
+}
+
+
+/*
+ * verify_curve2 - like ed25519_verify_curve for two signatures, whose
+ * point operations are interleaved with ed_dual_scale2. With strict set
+ * it checks the acceptance rule of the batch instead, like verify_strict.
+ */
+static void
+verify_curve2(bool ok[2], const uint8_t *sig[], const uint8_t *pub[],
+	      uint8_t t_in[][ED25519_VERIFY_HASH_LEN], bool strict)
+{
+	struct ed A[2], R[2], C[2];
+	sc_t t[2], S[2];
+	uint8_t check[32];
+	int k;
+
+	for (k = 0; k < 2; k++) {
+		if (strict) {
+			ok[k] = verify_import(&A[k], &R[k], S[k], sig[k], pub[k]);
+		} else {
+			ed_import(&A[k], pub[k]);
+			fld_neg(A[k].x, A[k].x);
+			fld_neg(A[k].t, A[k].t);
+
+			sc_import(S[k], sig[k]+32, 32);
+			ok[k] = true;
+		}
+		sc_import(t[k], t_in[k], 32);
+	}
+
+	/* the one valid signature alone */
+	if (!ok[0] || !ok[1]) {
+		for (k = 0; k < 2; k++) {
+			if (ok[k])
+				ok[k] = verify_strict(sig[k], pub[k], t_in[k]);
+		}
+		return;
+	}
+
+	ed_dual_scale2(C, (const sc_t *)S, (const sc_t *)t, A);
+
+	for (k = 0; k < 2; k++) {
+		if (strict) {
+			ok[k] = ed_cofactor_eq(&C[k], &R[k]);
+		} else {
+			ed_export_vartime(check, &C[k]);
+			ok[k] = (memcmp(check, sig[k], 32) == 0);
+		}
+	}
+}
+
+
+/*
+ * verify_pairs - verifies n signatures with their t_i from batch_hash
+ * one by one, but two at a time with verify_curve2. valid may be NULL,
+ * see verify_curve2 for strict.
+ *
+ * returns true if all signatures are ok.
+ */
+static bool
+verify_pairs(int n, bool valid[], uint8_t t[][ED25519_VERIFY_HASH_LEN],
+	     const uint8_t *sig[], const uint8_t *pub[], bool strict)
+{
+	bool ok[2], all = true;
+	int i;
+
+	for (i = 0; i < n; i += 2) {
+		if (i + 1 < n)
+			verify_curve2(ok, sig + i, pub + i, t + i, strict);
+		else if (strict)
+			ok[0] = ok[1] = verify_strict(sig[i], pub[i], t[i]);
+		else
+			ok[0] = ok[1] = ed25519_verify_curve(sig[i], pub[i], t[i]);
+
+		all &= ok[0] & ok[1];
+		if (valid != NULL) {
+			valid[i] = ok[0];
+			if (i + 1 < n)
+				valid[i+1] = ok[1];
+		} else if (!all)
+			return false;
+	}
+
+	return all;
+}
+
+
+/*
+ * ed25519_verify2 - verifies the two signatures sig[k] of msg[k] under
+ * pub[k] with interleaved point operations, see ed25519_verify_batch
+ * for valid.
+ *
+ * returns true if both signatures are ok and false otherwise.
+ */
+bool
+ed25519_verify2(bool valid[2], const uint8_t *sig[2], const uint8_t *pub[2],
+		const uint8_t *msg[2], const size_t len[2])
+{
+	uint8_t t[2][ED25519_VERIFY_HASH_LEN], h[2][SHA512_HASH_LENGTH];
+	struct sha512 ctx[2];
+	const struct sha512 *pctx[2];
+	struct batch b;
+
+	/* only the temporaries of batch_hash are needed */
+	b.t = t;
+	b.ctx = ctx;
+	b.pctx = pctx;
+	b.h = h;
+
+	batch_hash(&b, 2, sig, pub, msg, len);
+
+	return verify_pairs(2, valid, t, sig, pub, false);
+}
+
+
+/*
+ * batch_check_stack - like batch_check for up to VERIFY_BATCH signatures
+ * with the t_i in t and the other temporaries on the stack. it's not
+ * inlined, so neither the hashes nor the one by one checks run on top
+ * of them.
+ */
+static NOINLINE bool
+batch_check_stack(uint8_t t[][ED25519_VERIFY_HASH_LEN], int n,
+		  const uint8_t *sig[], const uint8_t *pub[])
+{
+	uint64_t mem[BATCH_LEN(VERIFY_BATCH) / 8];
+	struct batch b;
+
+	batch_setup(&b, mem, VERIFY_BATCH);
+	b.t = t;
+
+	return batch_check(&b, n, sig, pub);
+}
+
+
+/*
+ * verify_chunks - verifies n signatures in chunks of the given size
+ * with the temporaries b, see ed25519_verify_batch. if b has only the
+ * temporaries of batch_hash, the chunks go to batch_check_stack.
+ */
+static bool
+verify_chunks(struct batch *b, int chunk, size_t n, bool valid[],
+	      const uint8_t *sig[], const uint8_t *pub[],
+	      const uint8_t *msg[], const size_t len[])
+{
+	bool ok = true, batched;
+	int m, i;
+
+	while (n > 0) {
+		m = (n < (size_t)chunk) ? (int)n : chunk;
+
+		batch_hash(b, m, sig, pub, msg, len);
+
+		if (m < VERIFY_BATCH_MIN)
+			batched = false;
+		else if (b->multi != NULL)
+			batched = batch_check(b, m, sig, pub);
+		else
+			batched = batch_check_stack(b->t, m, sig, pub);
+
+		if (batched) {
+			if (valid != NULL) {
+				for (i = 0; i < m; i++)
+					valid[i] = true;
+			}
+		} else if (valid == NULL && m >= VERIFY_BATCH_MIN) {
+			return false;
+		} else {
+			/* short tail or find the bad ones */
+			ok &= verify_pairs(m, valid, b->t, sig, pub, true);
+			if (!ok && valid == NULL)
+				return false;
+		}
+
+		if (valid != NULL)
+			valid += m;
+		sig += m;
+		pub += m;
+		msg += m;
+		len += m;
+		n -= m;
+	}
+
+	return ok;
+}
+
+
+/*
+ * ed25519_verify_batch - verifies n signatures sig[i] of the msg[i] of
+ * length len[i] under the public keys pub[i].
+ *
+ * if valid is not NULL, valid[i] tells whether signature i is ok.
+ *
+ * note: like ed25519_verify this runs in vartime.
+ *
+ * returns true if all signatures are ok and false otherwise.
+ */
+bool
+ed25519_verify_batch(size_t n, bool valid[], const uint8_t *sig[],
+		     const uint8_t *pub[], const uint8_t *msg[],
+		     const size_t len[])
+{
+	uint8_t t[VERIFY_BATCH][ED25519_VERIFY_HASH_LEN];
+	uint8_t h[VERIFY_BATCH][SHA512_HASH_LENGTH];
+	struct sha512 ctx[VERIFY_BATCH];
+	const struct sha512 *pctx[VERIFY_BATCH];
+	struct batch b;
+
+	/* the temporaries of batch_hash, batch_check_stack has the others */
+	b.t = t;
+	b.multi = NULL;
+	b.ctx = ctx;
+	b.pctx = pctx;
+	b.h = h;
+
+	return verify_chunks(&b, VERIFY_BATCH, n, valid, sig, pub, msg, len);
+}
+
+
+/*
+ * ed25519_verify_batch_scratch_size - bytes of scratch memory
+ * ed25519_verify_batch_scratch needs for a batch of n signatures.
+ */
+size_t
+ed25519_verify_batch_scratch_size(size_t n)
+{
+	if (n > VERIFY_BATCH_MAX)
+		n = VERIFY_BATCH_MAX;
+
+	return BATCH_LEN(n);
+}
+
+
+/*
+ * ed25519_verify_batch_scratch - like ed25519_verify_batch, but with the
+ * temporaries in the scratch memory s, in chunks as large as fit.
+ *
+ * if s is too small for a single signature, all signatures count as bad.
+ */
+bool
+ed25519_verify_batch_scratch(const struct eddsa_scratch *s, size_t n,
+			     bool valid[], const uint8_t *sig[],
+			     const uint8_t *pub[], const uint8_t *msg[],
+			     const size_t len[])
+{
+	struct batch b;
+	size_t i;
+	int chunk;
+
+	chunk = (n < VERIFY_BATCH_MAX) ? (int)n : VERIFY_BATCH_MAX;
+	while (chunk > 0 && BATCH_LEN(chunk) > s->size)
+		chunk--;
+
+	if (chunk == 0) {
+		if (valid != NULL) {
+			for (i = 0; i < n; i++)
+				valid[i] = false;
+		}
+		return n == 0;
+	}
+
+	batch_setup(&b, s->mem, chunk);
+
+	return verify_chunks(&b, chunk, n, valid, sig, pub, msg, len);
+}
+
+
+/*
+ * number of keys pk_ed25519_to_x25519_batch converts with one inversion,
+ * the scratch variant takes up to PK_BATCH_MAX.
+ */
+#define PK_BATCH	32
+#define PK_BATCH_MAX	1024
+
+/* temporaries of pk_batch: num, den and inv for n keys */
+#define PK_BATCH_LEN(n)		(3 * SCRATCH_LEN((n) * sizeof(fld_t)))
+
+
+/*
+ * import_y - import only the y-coordinate of an ed25519 public key.
+ */
+static void
+import_y(fld_t y, const uint8_t in[ED25519_KEY_LEN])
+{
+	uint8_t tmp[32];
+
+	memcpy(tmp, in, 32);
+	tmp[31] &= 0x7f;
+	fld_import(y, tmp);
+}
+
+
 /*
  * pk_ed25519_to_x25519 - convert a ed25519 public key to x25519
  */
 void
 pk_ed25519_to_x25519(uint8_t out[X25519_KEY_LEN], const uint8_t in[ED25519_KEY_LEN])
 {
-	struct ed P;
-	fld_t u, t;
-
-	/* import ed25519 public key */
-	ed_import(&P, in);
+	fld_t y, u, t;
 
 	/*
-	 * We now have the point P = (x,y) on the curve
+	 * The point P = (x,y) on the curve
 	 *
 	 * 	x^2 + y^2 = 1 + (121665/121666)x^2y^2
 	 *
-	 * and want the u-component of the corresponding point
-	 * on the birationally equivalent montgomery curve
-	 *
-	 * 	v^2 = u^3 + 486662 u^2 + u.
-	 *
-	 *
-	 * From the paper [1] we get
-	 *
-	 * 	y = (u - 1) / (u + 1),
-	 *
-	 * which immediately yields
+	 * corresponds to a point with u-component
 	 *
 	 * 	u = (1 + y) / (1 - y)
 	 *
-	 * or, by using projective coordinantes,
+	 * on the birationally equivalent montgomery curve
+	 *
+	 * 	v^2 = u^3 + 486662 u^2 + u,
 	 *
-	 * 	u = (z + y) / (z - y).
+	 * see [1], so we neither need x nor have to check the sign bit.
 	 */
+	import_y(y, in);
 
-	/* u <- z + y */
-	fld_add(u, P.z, P.y);
+	/* u <- 1 + y */
+	fld_set0(t, 1);
+	fld_add(u, t, y);
 
-	/* t <- (z - y)^-1 */
-	fld_sub(t, P.z, P.y);
-	fld_inv(t, t);
+	/* t <- (1 - y)^-1, public key needs no constant-time inversion */
+	fld_sub(t, t, y);
+	fld_inv_vartime(t, t);
 
-	/* u <- u * t = (z+y) / (z-y) */
+	/* u <- u * t = (1+y) / (1-y) */
 	fld_mul(u, u, t);
 
 	/* export curve25519 public key */
@@ -232,6 +1363,112 @@ pk_ed25519_to_x25519(uint8_t out[X25519_KEY_LEN], const uint8_t in[ED25519_KEY_L
 }
 
 
+/*
+ * pk_batch - convert n public keys, sharing one inversion. mem holds
+ * PK_BATCH_LEN(n) bytes for the temporaries.
+ */
+static void
+pk_batch(int n, uint8_t *out, const uint8_t *in, void *mem)
+{
+	uint8_t *p = (uint8_t *)mem;
+	fld_t *num, *den, *inv;
+	fld_t one, y;
+	int i;
+
+	num = scratch_take(&p, n * sizeof(fld_t));
+	den = scratch_take(&p, n * sizeof(fld_t));
+	inv = scratch_take(&p, n * sizeof(fld_t));
+
+	fld_set0(one, 1);
+
+	for (i = 0; i < n; i++) {
+		import_y(y, in + i*ED25519_KEY_LEN);
+		fld_add(num[i], one, y);
+		fld_sub(den[i], one, y);
+	}
+
+	fld_inv_batch_vartime(inv, den, n);
+
+	for (i = 0; i < n; i++) {
+		fld_mul(num[i], num[i], inv[i]);
+		fld_export(out + i*X25519_KEY_LEN, num[i]);
+	}
+}
+
+
+/*
+ * pk_chunks - convert n public keys in chunks of the given size, with
+ * the temporaries in mem.
+ */
+static void
+pk_chunks(int chunk, size_t n, uint8_t *out, const uint8_t *in, void *mem)
+{
+	int m;
+
+	while (n > 0) {
+		m = (n < (size_t)chunk) ? (int)n : chunk;
+
+		pk_batch(m, out, in, mem);
+
+		out += m * X25519_KEY_LEN;
+		in += m * ED25519_KEY_LEN;
+		n -= m;
+	}
+}
+
+
+/*
+ * pk_ed25519_to_x25519_batch - convert n ed25519 public keys to x25519,
+ * where out and in hold n keys each.
+ */
+void
+pk_ed25519_to_x25519_batch(size_t n, uint8_t *out, const uint8_t *in)
+{
+	uint64_t mem[PK_BATCH_LEN(PK_BATCH) / 8];
+
+	pk_chunks(PK_BATCH, n, out, in, mem);
+}
+
+
+/*
+ * pk_ed25519_to_x25519_batch_scratch_size - bytes of scratch memory
+ * pk_ed25519_to_x25519_batch_scratch needs for a batch of n keys.
+ */
+size_t
+pk_ed25519_to_x25519_batch_scratch_size(size_t n)
+{
+	if (n > PK_BATCH_MAX)
+		n = PK_BATCH_MAX;
+
+	return PK_BATCH_LEN(n);
+}
+
+
+/*
+ * pk_ed25519_to_x25519_batch_scratch - like pk_ed25519_to_x25519_batch,
+ * but with the temporaries in the scratch memory s, in chunks as large
+ * as fit.
+ *
+ * returns false if s is too small for a single key.
+ */
+bool
+pk_ed25519_to_x25519_batch_scratch(const struct eddsa_scratch *s, size_t n,
+				   uint8_t *out, const uint8_t *in)
+{
+	size_t chunk;
+
+	chunk = s->size / PK_BATCH_LEN(1);
+	if (chunk > PK_BATCH_MAX)
+		chunk = PK_BATCH_MAX;
+	if (chunk == 0)
+		return false;
+
+	pk_chunks((int)chunk, n, out, in, s->mem);
+
+	return true;
+}
+
+
 
 /*
  * conv_sk_ed25519_to_x25519 - convert a ed25519 secret key to x25519 secret.
@@ -242,6 +1479,7 @@ conv_sk_ed25519_to_x25519(uint8_t out[X25519_KEY_LEN], const uint8_t in[ED25519_
 	uint8_t h[SHA512_HASH_LENGTH];
 	ed25519_key_setup(h, in);
 	memcpy(out, h, X25519_KEY_LEN);
+	burnlocal(h);
 }
 
 
@@ -252,7 +1490,7 @@ void
 sk_ed25519_to_x25519(uint8_t out[X25519_KEY_LEN], const uint8_t in[ED25519_KEY_LEN])
 {
 	conv_sk_ed25519_to_x25519(out, in);
-	burnstack(1024);
+	burnstack(2048);
 }
 
 
@@ -284,8 +1522,7 @@ eddsa_sign(uint8_t sig[ED25519_SIG_LEN],
 	   const uint8_t pub[ED25519_KEY_LEN],
 	   const uint8_t *data, size_t len)
 {
-	sign(sig, sec, pub, data, len);
-	burnstack(4096);
+	ed25519_sign(sig, sec, pub, data, len);
 }
 
 /*
@@ -320,5 +1557,5 @@ void
 eddsa_sk_eddsa_to_dh(uint8_t out[X25519_KEY_LEN], const uint8_t in[ED25519_KEY_LEN])
 {
 	conv_sk_ed25519_to_x25519(out, in);
-	burnstack(1024);
+	burnstack(2048);
 }
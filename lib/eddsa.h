@@ -5,6 +5,10 @@
 #include <stdbool.h>	/* foor bool */
 #include <stdint.h>	/* for uint8_t */
 
+#ifndef _WIN32
+#include <sys/uio.h>	/* for struct iovec */
+#endif
+
 #ifndef __has_attribute
 #define __has_attribute(x) 0
 #endif
@@ -53,6 +57,258 @@ EDDSA_DECL bool	ed25519_verify(const uint8_t sig[ED25519_SIG_LEN],
 			       const uint8_t pub[ED25519_KEY_LEN],
 			       const uint8_t *data, size_t len);
 
+#ifndef _WIN32
+/* sign and verify the concatenation of iovcnt buffers */
+EDDSA_DECL void	ed25519_signv(uint8_t sig[ED25519_SIG_LEN],
+			      const uint8_t sec[ED25519_KEY_LEN],
+			      const uint8_t pub[ED25519_KEY_LEN],
+			      const struct iovec *iov, int iovcnt);
+
+EDDSA_DECL bool	ed25519_verifyv(const uint8_t sig[ED25519_SIG_LEN],
+				const uint8_t pub[ED25519_KEY_LEN],
+				const struct iovec *iov, int iovcnt);
+#endif
+
+/*
+ * ed25519_verify split into hashing and curve arithmetic: verify_hash
+ * reduces the hash of the signed data to a 32 byte scalar t, which
+ * verify_curve needs together with sig and pub. The halves may run on
+ * different threads.
+ */
+
+#define ED25519_VERIFY_HASH_LEN	32
+
+EDDSA_DECL void	ed25519_verify_hash(uint8_t t[ED25519_VERIFY_HASH_LEN],
+				    const uint8_t sig[ED25519_SIG_LEN],
+				    const uint8_t pub[ED25519_KEY_LEN],
+				    const uint8_t *data, size_t len);
+
+EDDSA_DECL bool	ed25519_verify_curve(const uint8_t sig[ED25519_SIG_LEN],
+				     const uint8_t pub[ED25519_KEY_LEN],
+				     const uint8_t t[ED25519_VERIFY_HASH_LEN]);
+
+
+/*
+ * Step-wise verification
+ *
+ * ed25519_verify_start and ed25519_verify_step do the work of
+ * ed25519_verify in small portions, e.g. to interleave it with other
+ * work of an event loop. Each step does at most about ops point
+ * additions or doublings worth of work (a few hundred cycles each), a
+ * whole verification takes about 420 ops plus one per 128 bytes of data.
+ * Only the decompression of the public key can't be split, it costs
+ * about 28 ops.
+ *
+ * ed25519_verify_step returns -1 until the verification is finished,
+ * then 1 if the signature is ok and 0 if not. data must stay valid
+ * until then.
+ */
+
+#define ED25519_VERIFY_CTX_LEN	3072
+
+struct ed25519_verify_ctx {
+	uint64_t	opaque[ED25519_VERIFY_CTX_LEN / 8];
+};
+
+EDDSA_DECL void	ed25519_verify_start(struct ed25519_verify_ctx *ctx,
+				     const uint8_t sig[ED25519_SIG_LEN],
+				     const uint8_t pub[ED25519_KEY_LEN],
+				     const uint8_t *data, size_t len);
+
+EDDSA_DECL int	ed25519_verify_step(struct ed25519_verify_ctx *ctx,
+				    unsigned int ops);
+
+
+/*
+ * Scratch memory
+ *
+ * The library never allocates memory. The batch functions keep their
+ * temporaries on the stack, in chunks of a few elements, so they fit a
+ * stack of 16K, see the stack usage below. Their _scratch variants take
+ * the temporaries from memory of the caller instead (aligned for
+ * uint64_t, like the result of malloc), e.g. from a per-thread arena,
+ * and process chunks as large as fit into it, which is faster.
+ *
+ * The _scratch_size functions tell how many bytes a chunk of n elements
+ * takes, larger chunks than these are never used. The memory is not
+ * needed anymore after the call and holds no secrets then. The _scratch
+ * functions return false if it doesn't hold a single element.
+ */
+
+struct eddsa_scratch {
+	void		*mem;
+	size_t		size;
+};
+
+
+/*
+ * Batch verification
+ *
+ * sig, pub, msg and len are arrays of n entries. Signatures of the same
+ * public key are cheaper to verify together, so it pays to batch them.
+ * If valid is not NULL, valid[i] is set to whether signature i is ok.
+ *
+ * The batch accepts a signature (R, S) of the public key A exactly if R
+ * and A are canonical encodings of curve points, S < m and the
+ * cofactored equation 8*S*B = 8*R + 8*t*A holds. If the batch equation
+ * fails, the signatures are checked one by one with this rule, so the
+ * verdict doesn't depend on the batch. It can differ from the one of
+ * ed25519_verify, which checks S*B = R + t*A: R with a component of
+ * small order passes the batch only, S >= m and non-canonical R or A
+ * pass ed25519_verify only.
+ *
+ * returns true if all signatures are ok.
+ */
+
+EDDSA_DECL bool	ed25519_verify_batch(size_t n, bool valid[],
+				     const uint8_t *sig[],
+				     const uint8_t *pub[],
+				     const uint8_t *msg[],
+				     const size_t len[]);
+
+/*
+ * The scratch variant counts all signatures as bad if s is too small.
+ * ed25519_verify_batch works in chunks of 4 signatures, which take about
+ * twice the time per signature of chunks of 16. Chunks of more than 16
+ * signatures save up to 10% of the time, but a bad signature costs the
+ * check of all others in its chunk.
+ */
+EDDSA_DECL size_t ed25519_verify_batch_scratch_size(size_t n);
+
+EDDSA_DECL bool	ed25519_verify_batch_scratch(const struct eddsa_scratch *s,
+					     size_t n, bool valid[],
+					     const uint8_t *sig[],
+					     const uint8_t *pub[],
+					     const uint8_t *msg[],
+					     const size_t len[]);
+
+/*
+ * ed25519_verify2 checks two signatures like ed25519_verify, but with
+ * their computations interleaved, which keeps the cpu busier than one
+ * verification alone. The arguments are as for ed25519_verify_batch
+ * with n = 2.
+ */
+EDDSA_DECL bool	ed25519_verify2(bool valid[2], const uint8_t *sig[2],
+				const uint8_t *pub[2], const uint8_t *msg[2],
+				const size_t len[2]);
+
+
+/*
+ * Asynchronous verification queue
+ *
+ * Signatures submitted to the queue are verified by its worker threads
+ * in batches with ed25519_verify_batch, and cb(user, result) reports the
+ * result of each from one of the worker threads. The result follows the
+ * acceptance rule of the batch, whatever batch the signature ends up in.
+ * msg has to stay valid until then. A batch is verified as soon as
+ * max_batch signatures are queued or the oldest has waited max_wait
+ * microseconds.
+ *
+ * The queue lives in memory of the caller (aligned for uint64_t, like the
+ * result of malloc), ed25519_queue_size tells how many bytes it takes to
+ * hold size signatures. The workers verify with the _scratch variant of
+ * ed25519_verify_batch, so they need little stack.
+ *
+ * ed25519_queue_submit returns false if size signatures are waiting
+ * already. ed25519_queue_destroy verifies all waiting signatures before
+ * it returns, the memory may be freed after that. The latencies in the
+ * stats are measured from submission to the end of the batch. Only
+ * available with pthreads.
+ */
+
+struct ed25519_queue;
+
+typedef void	(*ed25519_queue_cb)(void *user, bool ok);
+
+struct ed25519_queue_stats {
+	size_t		depth;		/* signatures waiting right now */
+	size_t		max_depth;
+	uint64_t	submitted;
+	uint64_t	rejected;	/* queue was full */
+	uint64_t	completed;
+	uint64_t	batches;
+	uint64_t	latency_sum_us;	/* divide by completed for the mean */
+	uint64_t	latency_max_us;
+};
+
+EDDSA_DECL size_t ed25519_queue_size(size_t size, int threads,
+				     size_t max_batch);
+
+EDDSA_DECL struct ed25519_queue *
+		ed25519_queue_init(void *mem, size_t memsize, size_t size,
+				   int threads, size_t max_batch,
+				   unsigned long max_wait);
+
+EDDSA_DECL bool	ed25519_queue_submit(struct ed25519_queue *q,
+				     const uint8_t sig[ED25519_SIG_LEN],
+				     const uint8_t pub[ED25519_KEY_LEN],
+				     const uint8_t *msg, size_t len,
+				     ed25519_queue_cb cb, void *user);
+
+EDDSA_DECL void	ed25519_queue_stats(struct ed25519_queue *q,
+				    struct ed25519_queue_stats *stats);
+
+EDDSA_DECL void	ed25519_queue_destroy(struct ed25519_queue *q);
+
+
+/*
+ * Hot keys
+ *
+ * For a public key which verifies lots of signatures, a hot key holds a
+ * large table of its multiples, so that ed25519_verify_hotkey needs no
+ * doublings and runs about three times faster than ed25519_verify.
+ *
+ * The table lives in memory of the caller (aligned for uint64_t, like
+ * the result of malloc). ed25519_hotkey_size tells how many bytes of a
+ * budget the largest fitting table takes, or 0 if the budget is too
+ * small. The tables grow in steps of about 60KB, 96KB, 160KB, 280KB,
+ * 480KB and 870KB. The larger ones are faster as long as they fit into
+ * the cache; more memory than 870KB is never used.
+ *
+ * Setting up the table costs about as much as 6 (smallest table) up to
+ * 60 (largest table) calls of ed25519_verify.
+ * ed25519_hotkey_init returns NULL if size is too small.
+ */
+
+struct ed25519_hotkey;
+
+EDDSA_DECL size_t ed25519_hotkey_size(size_t budget);
+
+EDDSA_DECL struct ed25519_hotkey *
+		ed25519_hotkey_init(void *mem, size_t size,
+				    const uint8_t pub[ED25519_KEY_LEN]);
+
+EDDSA_DECL bool	ed25519_verify_hotkey(const uint8_t sig[ED25519_SIG_LEN],
+				      const struct ed25519_hotkey *key,
+				      const uint8_t *data, size_t len);
+
+
+/*
+ * External SHA-512
+ *
+ * ed25519_set_sha512 makes the ed25519 functions use another SHA-512
+ * implementation (e.g. of a platform library) instead of the builtin one.
+ * The context of the provider lives on the stack of the calling function,
+ * so ctx_size must not exceed ED25519_SHA512_CTX_MAX and the context
+ * must not need more than 8 byte alignment.
+ *
+ * Passing NULL switches back to the builtin implementation. Switching is
+ * not thread-safe, so do it before using the library from other threads.
+ *
+ * returns false if the provider is incomplete or its context too large.
+ */
+
+#define ED25519_SHA512_CTX_MAX	512
+
+struct ed25519_sha512_provider {
+	size_t	ctx_size;
+	void	(*init)(void *ctx);
+	void	(*update)(void *ctx, const uint8_t *data, size_t len);
+	void	(*final)(void *ctx, uint8_t out[64]);
+};
+
+EDDSA_DECL bool	ed25519_set_sha512(const struct ed25519_sha512_provider *p);
+
 
 
 /*
@@ -68,6 +324,122 @@ EDDSA_DECL void	x25519(uint8_t out[X25519_KEY_LEN],
 		       const uint8_t scalar[X25519_KEY_LEN],
 		       const uint8_t point[X25519_KEY_LEN]);
 
+/* out, scalars and points hold n keys of X25519_KEY_LEN bytes each */
+EDDSA_DECL void	x25519_batch(size_t n, uint8_t *outs,
+			     const uint8_t *scalars,
+			     const uint8_t *points);
+
+EDDSA_DECL void	x25519_base_batch(size_t n, uint8_t *outs,
+				  const uint8_t *scalars);
+
+EDDSA_DECL size_t x25519_batch_scratch_size(size_t n);
+
+EDDSA_DECL bool	x25519_batch_scratch(const struct eddsa_scratch *s, size_t n,
+				     uint8_t *outs, const uint8_t *scalars,
+				     const uint8_t *points);
+
+EDDSA_DECL size_t x25519_base_batch_scratch_size(size_t n);
+
+EDDSA_DECL bool	x25519_base_batch_scratch(const struct eddsa_scratch *s,
+					  size_t n, uint8_t *outs,
+					  const uint8_t *scalars);
+
+
+/*
+ * X25519 with a fixed peer
+ *
+ * x25519_peer_init precomputes a lookup table for the public key of a
+ * peer, so that x25519_with_peer runs at the speed of x25519_base. The
+ * context takes X25519_PEER_CTX_LEN (about 30KB) of memory and setting
+ * it up costs about as much as 8 calls of x25519, so it pays off after
+ * about 11 uses with the same peer (about 25 with the 32bit field code).
+ *
+ * Keys on the twist can't be mapped to the edwards curve, for them
+ * x25519_with_peer silently uses the normal ladder.
+ */
+
+#define X25519_PEER_CTX_LEN	30784
+
+struct x25519_peer_ctx {
+	uint64_t	opaque[X25519_PEER_CTX_LEN / 8];
+};
+
+EDDSA_DECL void	x25519_peer_init(struct x25519_peer_ctx *ctx,
+				 const uint8_t point[X25519_KEY_LEN]);
+
+EDDSA_DECL void	x25519_with_peer(uint8_t out[X25519_KEY_LEN],
+				 const uint8_t scalar[X25519_KEY_LEN],
+				 const struct x25519_peer_ctx *ctx);
+
+
+/*
+ * Pool of ephemeral X25519 keypairs
+ *
+ * The pool is refilled by background threads, so taking a keypair (sec,
+ * pub) with pub = x25519_base(sec) is cheap. Secrets are wiped from the
+ * pool when taken and on destruction. The pool lives in memory of the
+ * caller (aligned for uint64_t, like the result of malloc), of
+ * x25519_ephemeral_pool_size bytes. Only available with pthreads.
+ */
+
+struct x25519_pool;
+
+EDDSA_DECL size_t x25519_ephemeral_pool_size(size_t size, int threads);
+
+EDDSA_DECL struct x25519_pool *
+		x25519_ephemeral_pool_init(void *mem, size_t memsize,
+					   size_t size, int threads);
+
+EDDSA_DECL bool	x25519_ephemeral_pool_take(struct x25519_pool *pool,
+					   uint8_t sec[X25519_KEY_LEN],
+					   uint8_t pub[X25519_KEY_LEN]);
+
+EDDSA_DECL void	x25519_ephemeral_pool_destroy(struct x25519_pool *pool);
+
+
+/*
+ * Cache of verification results
+ *
+ * ed25519_verify_cached remembers the results of ed25519_verify, so
+ * that verifying the same signature of the same message again only costs
+ * a hash of the message. The results are looked up by a digest keyed
+ * with a random secret of the cache, so the cache can't be poisoned and
+ * a result never applies to another message or signature.
+ *
+ * flags select which results get cached, usually only the valid ones.
+ * The cache lives in memory of the caller (aligned for uint64_t, like the
+ * result of malloc) and holds as many results as fit into it, a cache
+ * of at least size results takes ed25519_cache_size(size) bytes. It is
+ * safe to use from several threads. Only available with pthreads.
+ */
+
+#define ED25519_CACHE_VALID	1	/* cache valid signatures */
+#define ED25519_CACHE_INVALID	2	/* cache invalid signatures */
+
+struct ed25519_cache;
+
+struct ed25519_cache_stats {
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	inserts;
+	uint64_t	evictions;
+};
+
+EDDSA_DECL size_t ed25519_cache_size(size_t size);
+
+EDDSA_DECL struct ed25519_cache *
+		ed25519_cache_init(void *mem, size_t size, unsigned int flags);
+
+EDDSA_DECL bool	ed25519_verify_cached(struct ed25519_cache *cache,
+				      const uint8_t sig[ED25519_SIG_LEN],
+				      const uint8_t pub[ED25519_KEY_LEN],
+				      const uint8_t *data, size_t len);
+
+EDDSA_DECL void	ed25519_cache_stats(struct ed25519_cache *cache,
+				    struct ed25519_cache_stats *stats);
+
+EDDSA_DECL void	ed25519_cache_destroy(struct ed25519_cache *cache);
+
 
 
 /*
@@ -77,11 +449,51 @@ EDDSA_DECL void	x25519(uint8_t out[X25519_KEY_LEN],
 EDDSA_DECL void pk_ed25519_to_x25519(uint8_t out[X25519_KEY_LEN],
 				     const uint8_t in[ED25519_KEY_LEN]);
 
+/* out and in hold n keys each, all conversions share one inversion */
+EDDSA_DECL void pk_ed25519_to_x25519_batch(size_t n, uint8_t *outs,
+					   const uint8_t *ins);
+
+EDDSA_DECL size_t pk_ed25519_to_x25519_batch_scratch_size(size_t n);
+
+EDDSA_DECL bool	pk_ed25519_to_x25519_batch_scratch(const struct eddsa_scratch *s,
+						   size_t n, uint8_t *outs,
+						   const uint8_t *ins);
+
 EDDSA_DECL void sk_ed25519_to_x25519(uint8_t out[X25519_KEY_LEN],
 				     const uint8_t in[ED25519_KEY_LEN]);
 
 
 
+/*
+ * Stack usage
+ *
+ * Worst-case stack depth of the functions in KB, including the
+ * clean-up of the stack (USE_STACKCLEAN), as measured by selftest-stack
+ * for x86-64 and gcc. Other compilers and targets may differ a bit.
+ *
+ *	ed25519_genpub, sk_ed25519_to_x25519		 3K
+ *	ed25519_sign, ed25519_signv			 4K
+ *	ed25519_verify(v), ed25519_verify_step		 3K
+ *	ed25519_verify_hotkey				 3K
+ *	ed25519_verify2					 9K
+ *	ed25519_verify_batch				14K
+ *	ed25519_hotkey_init				10K
+ *	x25519_base, pk_ed25519_to_x25519		 3K
+ *	x25519, x25519_peer_init, x25519_with_peer	 5K (3K with 64bit code)
+ *	x25519_batch					12K
+ *	x25519_base_batch, pk_ed25519_to_x25519_batch	 7K
+ *
+ * So the functions for a single element fit a stack of 8K and the others
+ * one of 16K. The _scratch variants of the batch functions need about
+ * as much as the functions for a single element, but up to 7K for
+ * ed25519_verify_batch_scratch and 9K for x25519_batch_scratch.
+ *
+ * The verification cache needs about as much as ed25519_verify, the
+ * worker threads of the pool and the queue run on stacks of their own.
+ */
+
+
+
 
 
 /*
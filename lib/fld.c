@@ -6,6 +6,8 @@
  * Philipp Lay <philipp.lay@illunis.net>
  */
 
+#include <string.h>
+
 #include "bitness.h"
 #include "fld.h"
 
@@ -41,6 +43,17 @@ const fld_t con_j = {
 	765476049583133 };
 
 
+/*
+ * parameters for fld_inv_vartime: q in signed 62-bit limbs and
+ * q^-1 modulo 2^62.
+ */
+#define INV_LIMB_NUM		5
+#define INV_LIMB_BITS		62
+
+static const limb_t inv_q[INV_LIMB_NUM] = { -19, 0, 0, 0, 128 };
+static const limb_t inv_qinv = 4126245384908715493;
+
+
 
 /*
  * fld_reduce - returns the smallest non-negative representation of x modulo q
@@ -279,6 +292,72 @@ fld_sq(fld_t res, const fld_t x)
 	res[4] = c[4] & FLD_LIMB_MASK;
 }
 
+/*
+ * fld_sqn - square x n times and reduce modulo q, ie res = x^(2^n).
+ *
+ * this is used for the long squaring chains in fld_inv and fld_pow2523:
+ * the limbs stay in local variables between the squarings and each
+ * round is only carried as far as needed to be fed into the next one.
+ */
+void
+fld_sqn(fld_t res, const fld_t x, int n)
+{
+	limb_t x0, x1, x2, x3, x4;
+	limb_t x2_1, x2_2, x2_3, x2_4, x19_3, x19_4;
+	llimb_t c0, c1, c2, c3, c4;
+
+	x0 = x[0];
+	x1 = x[1];
+	x2 = x[2];
+	x3 = x[3];
+	x4 = x[4];
+
+	for (; n > 0; n--) {
+		x2_1 = 2*x1;
+		x2_2 = 2*x2;
+		x2_3 = 2*x3;
+		x2_4 = 2*x4;
+		x19_3 = 19*x3;
+		x19_4 = 19*x4;
+
+		c0 = (llimb_t)x0*x0 + (llimb_t)x2_1*x19_4 + (llimb_t)x2_2*x19_3;
+		c1 = (llimb_t)x0*x2_1 + (llimb_t)x2_2*x19_4 + (llimb_t)x19_3*x3;
+		c2 = (llimb_t)x0*x2_2 + (llimb_t)x1*x1 + (llimb_t)x2_3*x19_4;
+		c3 = (llimb_t)x0*x2_3 + (llimb_t)x2_1*x2 + (llimb_t)x19_4*x4;
+		c4 = (llimb_t)x0*x2_4 + (llimb_t)x2_1*x3 + (llimb_t)x2*x2;
+
+		/*
+		 * carry in two interleaved chains, c0 -> c1 -> c2 -> c3 -> c4
+		 * and c3 -> c4 -> c0 -> c1, which shortens the critical path
+		 * from six to four carries.
+		 */
+		c1 += c0 >> FLD_LIMB_BITS;
+		c0 &= FLD_LIMB_MASK;
+		c4 += c3 >> FLD_LIMB_BITS;
+		c3 &= FLD_LIMB_MASK;
+
+		c2 += c1 >> FLD_LIMB_BITS;
+		x1 = c1 & FLD_LIMB_MASK;
+		c0 += 19*(c4 >> FLD_LIMB_BITS);
+		x4 = c4 & FLD_LIMB_MASK;
+
+		c3 += c2 >> FLD_LIMB_BITS;
+		x2 = c2 & FLD_LIMB_MASK;
+		x1 += c0 >> FLD_LIMB_BITS;
+		x0 = c0 & FLD_LIMB_MASK;
+
+		/* x1 and x4 may exceed 51 bits a little, which is fine as input */
+		x4 += c3 >> FLD_LIMB_BITS;
+		x3 = c3 & FLD_LIMB_MASK;
+	}
+
+	res[0] = x0;
+	res[1] = x1;
+	res[2] = x2;
+	res[3] = x3;
+	res[4] = x4;
+}
+
 #else		/* USE_64BIT */
 
 
@@ -306,6 +385,17 @@ const fld_t con_j = { 34513072, 25610706, 9377949, 3500415, 12389472, 33281959,
 		      41962654, 31548777, 326685, 11406482 };
 
 
+/*
+ * parameters for fld_inv_vartime: q in signed 30-bit limbs and
+ * q^-1 modulo 2^30.
+ */
+#define INV_LIMB_NUM		9
+#define INV_LIMB_BITS		30
+
+static const limb_t inv_q[INV_LIMB_NUM] = { -19, 0, 0, 0, 0, 0, 0, 0, 32768 };
+static const limb_t inv_qinv = 395589093;
+
+
 /*
  * macro for doing one carry-reduce round
  *
@@ -497,13 +587,16 @@ fld_mul(fld_t dst, const fld_t a, const fld_t b)
 }
 
 /*
- * fld_sq - square x and reduce modulo q.
+ * square - helper for fld_sq and fld_sqn, squares a into c and does
+ * one carry round.
+ *
+ * afterwards all limbs of c fit into their limb size, except c[0]
+ * which could still hold about 40 bits.
  */
-void
-fld_sq(fld_t dst, const fld_t a)
+static INLINE void
+square(llimb_t c[10], const fld_t a)
 {
 	llimb_t tmp;
-	llimb_t c[10];
 
 	c[0] = (llimb_t)a[0]*a[0];
 	c[1] = (llimb_t)2*a[0]*a[1];
@@ -527,9 +620,52 @@ fld_sq(fld_t dst, const fld_t a)
 	c[8] += 19*2*(llimb_t)a[9]*a[9];
 
 	CARRY(c, c, tmp, 0);
+}
+
+/*
+ * fld_sq - square x and reduce modulo q.
+ */
+void
+fld_sq(fld_t dst, const fld_t a)
+{
+	llimb_t tmp;
+	llimb_t c[10];
+
+	square(c, a);
 	CARRY(dst, c, tmp, 0);
 }
 
+/*
+ * fld_sqn - square x n times and reduce modulo q, ie res = x^(2^n).
+ *
+ * this is used for the long squaring chains in fld_inv and fld_pow2523:
+ * instead of a second full carry round after each squaring, like
+ * fld_sq does, we only carry the overflow of the lowest limb into the
+ * next one. this is enough to feed the result into the next squaring.
+ */
+void
+fld_sqn(fld_t dst, const fld_t a, int n)
+{
+	llimb_t c[10];
+	fld_t t;
+	int i;
+
+	for (i = 0; i < FLD_LIMB_NUM; i++)
+		t[i] = a[i];
+
+	for (; n > 0; n--) {
+		square(c, t);
+
+		t[0] = c[0] & FLD_LIMB_MASK(1);
+		t[1] = c[1] + (c[0] >> FLD_LIMB_BITS(1));
+		for (i = 2; i < FLD_LIMB_NUM; i++)
+			t[i] = c[i];
+	}
+
+	for (i = 0; i < FLD_LIMB_NUM; i++)
+		dst[i] = t[i];
+}
+
 #endif		/* USE_64BIT */
 
 
@@ -569,79 +705,388 @@ fld_eq(const fld_t a, const fld_t b)
 
 
 /*
- * fld_inv - inverts z modulo q.
+ * fld_pow22501 - helper for fld_inv and fld_pow2523, computes
+ * z^(2^250 - 1) and z^11.
  *
- * this code is taken from nacl. it works by taking z to the q-2
- * power. by lagrange's theorem (aka 'fermat's little theorem' in this
- * special case) this gives us z^-1 modulo q.
+ * the addition chain is taken from nacl.
  */
-void
-fld_inv(fld_t res, const fld_t z)
+static void
+fld_pow22501(fld_t res, fld_t z11, const fld_t z)
 {
 	fld_t z2;
 	fld_t z9;
-	fld_t z11;
 	fld_t z2_5_0;
 	fld_t z2_10_0;
 	fld_t z2_20_0;
 	fld_t z2_50_0;
 	fld_t z2_100_0;
-	fld_t t0;
-	fld_t t1;
-	int i;
+	fld_t t;
 
 	/* 2 */ fld_sq(z2, z);
-	/* 4 */ fld_sq(t1, z2);
-	/* 8 */ fld_sq(t0, t1);
-	/* 9 */ fld_mul(z9,t0, z);
+	/* 8 */ fld_sqn(t, z2, 2);
+	/* 9 */ fld_mul(z9, t, z);
 	/* 11 */ fld_mul(z11, z9, z2);
-	/* 22 */ fld_sq(t0, z11);
-	/* 2^5 - 2^0 = 31 */ fld_mul(z2_5_0, t0, z9);
-
-	/* 2^6 - 2^1 */ fld_sq(t0, z2_5_0);
-	/* 2^7 - 2^2 */ fld_sq(t1, t0);
-	/* 2^8 - 2^3 */ fld_sq(t0, t1);
-	/* 2^9 - 2^4 */ fld_sq(t1, t0);
-	/* 2^10 - 2^5 */ fld_sq(t0, t1);
-	/* 2^10 - 2^0 */ fld_mul(z2_10_0, t0, z2_5_0);
-
-	/* 2^11 - 2^1 */ fld_sq(t0, z2_10_0);
-	/* 2^12 - 2^2 */ fld_sq(t1, t0);
-	/* 2^20 - 2^10 */ for (i = 2; i < 10; i += 2) { fld_sq(t0, t1); fld_sq(t1, t0); }
-	/* 2^20 - 2^0 */ fld_mul(z2_20_0, t1, z2_10_0);
-
-	/* 2^21 - 2^1 */ fld_sq(t0, z2_20_0);
-	/* 2^22 - 2^2 */ fld_sq(t1, t0);
-	/* 2^40 - 2^20 */ for (i = 2;i < 20;i += 2) { fld_sq(t0, t1); fld_sq(t1, t0); }
-	/* 2^40 - 2^0 */ fld_mul(t0, t1, z2_20_0);
-
-	/* 2^41 - 2^1 */ fld_sq(t1, t0);
-	/* 2^42 - 2^2 */ fld_sq(t0, t1);
-	/* 2^50 - 2^10 */ for (i = 2; i < 10; i += 2) { fld_sq(t1, t0); fld_sq(t0, t1); }
-	/* 2^50 - 2^0 */ fld_mul(z2_50_0, t0, z2_10_0);
-
-	/* 2^51 - 2^1 */ fld_sq(t0, z2_50_0);
-	/* 2^52 - 2^2 */ fld_sq(t1, t0);
-	/* 2^100 - 2^50 */ for (i = 2; i < 50; i += 2) { fld_sq(t0, t1); fld_sq(t1, t0); }
-	/* 2^100 - 2^0 */ fld_mul(z2_100_0, t1, z2_50_0);
-
-	/* 2^101 - 2^1 */ fld_sq(t1, z2_100_0);
-	/* 2^102 - 2^2 */ fld_sq(t0, t1);
-	/* 2^200 - 2^100 */ for (i = 2; i < 100; i += 2) { fld_sq(t1, t0); fld_sq(t0, t1); }
-	/* 2^200 - 2^0 */ fld_mul(t1, t0, z2_100_0);
-
-	/* 2^201 - 2^1 */ fld_sq(t0, t1);
-	/* 2^202 - 2^2 */ fld_sq(t1, t0);
-	/* 2^250 - 2^50 */ for (i = 2; i < 50; i += 2) { fld_sq(t0, t1); fld_sq(t1, t0); }
-	/* 2^250 - 2^0 */ fld_mul(t0, t1, z2_50_0);
-
-	/* 2^251 - 2^1 */ fld_sq(t1, t0);
-	/* 2^252 - 2^2 */ fld_sq(t0, t1);
-	
-	/* 2^253 - 2^3 */ fld_sq(t1, t0);
-	/* 2^254 - 2^4 */ fld_sq(t0, t1);
-	/* 2^255 - 2^5 */ fld_sq(t1, t0);
-	/* 2^255 - 21 */ fld_mul(res, t1, z11);
+	/* 22 */ fld_sq(t, z11);
+	/* 2^5 - 2^0 = 31 */ fld_mul(z2_5_0, t, z9);
+
+	/* 2^10 - 2^5 */ fld_sqn(t, z2_5_0, 5);
+	/* 2^10 - 2^0 */ fld_mul(z2_10_0, t, z2_5_0);
+
+	/* 2^20 - 2^10 */ fld_sqn(t, z2_10_0, 10);
+	/* 2^20 - 2^0 */ fld_mul(z2_20_0, t, z2_10_0);
+
+	/* 2^40 - 2^20 */ fld_sqn(t, z2_20_0, 20);
+	/* 2^40 - 2^0 */ fld_mul(t, t, z2_20_0);
+
+	/* 2^50 - 2^10 */ fld_sqn(t, t, 10);
+	/* 2^50 - 2^0 */ fld_mul(z2_50_0, t, z2_10_0);
+
+	/* 2^100 - 2^50 */ fld_sqn(t, z2_50_0, 50);
+	/* 2^100 - 2^0 */ fld_mul(z2_100_0, t, z2_50_0);
+
+	/* 2^200 - 2^100 */ fld_sqn(t, z2_100_0, 100);
+	/* 2^200 - 2^0 */ fld_mul(t, t, z2_100_0);
+
+	/* 2^250 - 2^50 */ fld_sqn(t, t, 50);
+	/* 2^250 - 2^0 */ fld_mul(res, t, z2_50_0);
+}
+
+
+/*
+ * fld_inv - inverts z modulo q.
+ *
+ * this code is taken from nacl. it works by taking z to the q-2
+ * power. by lagrange's theorem (aka 'fermat's little theorem' in this
+ * special case) this gives us z^-1 modulo q.
+ */
+void
+fld_inv(fld_t res, const fld_t z)
+{
+	fld_t z11;
+	fld_t t;
+
+	/* 2^250 - 2^0 */ fld_pow22501(t, z11, z);
+	/* 2^255 - 2^5 */ fld_sqn(t, t, 5);
+	/* 2^255 - 21 */ fld_mul(res, t, z11);
+}
+
+
+/*
+ * inv_batch - inverts the n elements of z into res with montgomery's
+ * trick, i.e. with a single call to inv and 3*(n-1) multiplications.
+ *
+ * as with fld_inv zero is mapped to zero, without affecting the other
+ * elements. z is not modified, but must not overlap with res.
+ */
+static void
+inv_batch(fld_t res[], fld_t z[], int n, void (*inv)(fld_t, const fld_t))
+{
+	fld_t zero, acc, t;
+	limb_t iszero;
+	int i;
+
+	if (n <= 0)
+		return;
+
+	fld_set0(zero, 0);
+
+	/* res[i] <- z[0] * ... * z[i], where zeros are replaced by one */
+	fld_set0(acc, 1);
+	for (i = 0; i < n; i++) {
+		memcpy(t, z[i], sizeof(fld_t));
+		t[0] += fld_eq(z[i], zero);
+		fld_mul(acc, acc, t);
+		memcpy(res[i], acc, sizeof(fld_t));
+	}
+
+	inv(acc, res[n-1]);
+
+	/* now acc is 1 / (z[0] * ... * z[i]) */
+	for (i = n-1; i >= 0; i--) {
+		iszero = fld_eq(z[i], zero);
+
+		if (i > 0) {
+			fld_mul(res[i], acc, res[i-1]);
+			memcpy(t, z[i], sizeof(fld_t));
+			t[0] += iszero;
+			fld_mul(acc, acc, t);
+		} else
+			memcpy(res[i], acc, sizeof(fld_t));
+
+		fld_tinyscale(res[i], res[i], 1 - iszero);
+	}
+}
+
+
+/*
+ * fld_inv_batch - inverts the n elements of z into res with a single
+ * call to fld_inv, see inv_batch.
+ */
+void
+fld_inv_batch(fld_t res[], fld_t z[], int n)
+{
+	inv_batch(res, z, n, fld_inv);
+}
+
+
+/*
+ * variable-time inversion
+ *
+ * fld_inv_vartime uses the safegcd algorithm of bernstein and yang
+ * with the divstep batching and modular update from libsecp256k1.
+ * numbers are held in signed INV_LIMB_BITS-bit limbs, where only the
+ * topmost limb may be negative.
+ */
+
+#define INV_LIMB_MASK		(((limb_t)1 << INV_LIMB_BITS) - 1)
+
+typedef limb_t inv_t[INV_LIMB_NUM];
+
+
+/*
+ * inv_import - convert field element x to signed limb format.
+ */
+static void
+inv_import(inv_t dst, const fld_t x)
+{
+	uint8_t buf[32];
+	llimb_t foo = 0;
+	int fill = 0;
+	int i, k = 0;
+
+	fld_export(buf, x);
+
+	for (i = 0; i < INV_LIMB_NUM; i++) {
+		for (; fill < INV_LIMB_BITS && k < 32; fill += 8)
+			foo |= (llimb_t)buf[k++] << fill;
+
+		dst[i] = foo & INV_LIMB_MASK;
+		foo >>= INV_LIMB_BITS;
+		fill -= INV_LIMB_BITS;
+	}
+}
+
+
+/*
+ * inv_export - convert x from signed limb format back to a field element.
+ *
+ * assumes:
+ *   0 <= x < q and x is carried
+ */
+static void
+inv_export(fld_t dst, const inv_t x)
+{
+	uint8_t buf[32];
+	llimb_t foo = 0;
+	int fill = 0;
+	int i, k = 0;
+
+	for (i = 0; i < INV_LIMB_NUM; i++) {
+		foo |= (llimb_t)x[i] << fill;
+		for (fill += INV_LIMB_BITS; fill >= 8 && k < 32; fill -= 8, foo >>= 8)
+			buf[k++] = foo & 0xff;
+	}
+
+	fld_import(dst, buf);
+}
+
+
+/*
+ * inv_carry - carry x, so that all but the top limb are non-negative.
+ */
+static void
+inv_carry(inv_t x)
+{
+	int i;
+
+	for (i = 0; i < INV_LIMB_NUM-1; i++) {
+		x[i+1] += x[i] >> INV_LIMB_BITS;
+		x[i] &= INV_LIMB_MASK;
+	}
+}
+
+
+/*
+ * inv_divsteps - do INV_LIMB_BITS divsteps on the lowest limbs f and g
+ * and return the new delta. (vartime)
+ *
+ * the transition matrix t = (u, v, q, r) is scaled by 2^INV_LIMB_BITS,
+ * that is 2^INV_LIMB_BITS * (f', g') = (u*f + v*g, q*f + r*g).
+ */
+static int
+inv_divsteps(int delta, limb_t f, limb_t g, limb_t t[4])
+{
+	limb_t u = 1, v = 0, q = 0, r = 1;
+	limb_t tmp;
+	int i;
+
+	for (i = 0; i < INV_LIMB_BITS; i++) {
+		if (g & 1) {
+			if (delta > 0) {
+				/* (f, g) <- (g, -f) */
+				delta = -delta;
+				tmp = f; f = g; g = -tmp;
+				tmp = u; u = q; q = -tmp;
+				tmp = v; v = r; r = -tmp;
+			}
+			g += f;
+			q += u;
+			r += v;
+		}
+
+		delta++;
+		g >>= 1;
+		u += u;
+		v += v;
+	}
+
+	t[0] = u;
+	t[1] = v;
+	t[2] = q;
+	t[3] = r;
+
+	return delta;
+}
+
+
+/*
+ * inv_update_fg - replace (f, g) by t * (f, g) / 2^INV_LIMB_BITS.
+ */
+static void
+inv_update_fg(inv_t f, inv_t g, const limb_t t[4])
+{
+	llimb_t cf, cg;
+	int i;
+
+	cf = (llimb_t)t[0]*f[0] + (llimb_t)t[1]*g[0];
+	cg = (llimb_t)t[2]*f[0] + (llimb_t)t[3]*g[0];
+
+	for (i = 1; i < INV_LIMB_NUM; i++) {
+		/* lowest INV_LIMB_BITS are zero by construction of t */
+		cf >>= INV_LIMB_BITS;
+		cg >>= INV_LIMB_BITS;
+
+		cf += (llimb_t)t[0]*f[i] + (llimb_t)t[1]*g[i];
+		cg += (llimb_t)t[2]*f[i] + (llimb_t)t[3]*g[i];
+
+		f[i-1] = cf & INV_LIMB_MASK;
+		g[i-1] = cg & INV_LIMB_MASK;
+	}
+
+	f[INV_LIMB_NUM-1] = cf >> INV_LIMB_BITS;
+	g[INV_LIMB_NUM-1] = cg >> INV_LIMB_BITS;
+}
+
+
+/*
+ * inv_update_de - replace (d, e) by t * (d, e) / 2^INV_LIMB_BITS modulo q.
+ *
+ * we add a multiple of q to make the division exact. if d and e are
+ * in the range (-2q, q) the result will be in this range, too.
+ */
+static void
+inv_update_de(inv_t d, inv_t e, const limb_t t[4])
+{
+	llimb_t cd, ce;
+	limb_t sd, se, md, me;
+	int i;
+
+	/* start with md, me from the sign of d and e to stay in range */
+	sd = d[INV_LIMB_NUM-1] >> (8*sizeof(limb_t)-1);
+	se = e[INV_LIMB_NUM-1] >> (8*sizeof(limb_t)-1);
+	md = (t[0] & sd) + (t[1] & se);
+	me = (t[2] & sd) + (t[3] & se);
+
+	cd = (llimb_t)t[0]*d[0] + (llimb_t)t[1]*e[0];
+	ce = (llimb_t)t[2]*d[0] + (llimb_t)t[3]*e[0];
+
+	/* correct md, me such that the lowest INV_LIMB_BITS vanish */
+	md -= (inv_qinv * (limb_t)cd + md) & INV_LIMB_MASK;
+	me -= (inv_qinv * (limb_t)ce + me) & INV_LIMB_MASK;
+
+	cd += (llimb_t)inv_q[0]*md;
+	ce += (llimb_t)inv_q[0]*me;
+
+	for (i = 1; i < INV_LIMB_NUM; i++) {
+		cd >>= INV_LIMB_BITS;
+		ce >>= INV_LIMB_BITS;
+
+		cd += (llimb_t)t[0]*d[i] + (llimb_t)t[1]*e[i] + (llimb_t)inv_q[i]*md;
+		ce += (llimb_t)t[2]*d[i] + (llimb_t)t[3]*e[i] + (llimb_t)inv_q[i]*me;
+
+		d[i-1] = cd & INV_LIMB_MASK;
+		e[i-1] = ce & INV_LIMB_MASK;
+	}
+
+	d[INV_LIMB_NUM-1] = cd >> INV_LIMB_BITS;
+	e[INV_LIMB_NUM-1] = ce >> INV_LIMB_BITS;
+}
+
+
+/*
+ * fld_inv_vartime - inverts z modulo q in variable time.
+ *
+ * this is much faster than fld_inv, but leaks z through timing, so
+ * use this only on public values. like fld_inv, zero is mapped to zero.
+ */
+void
+fld_inv_vartime(fld_t res, const fld_t z)
+{
+	inv_t d, e, f, g;
+	limb_t t[4];
+	limb_t nz;
+	int delta = 1;
+	int i;
+
+	/* start with f = q, g = z, d = 0, e = 1 */
+	for (i = 0; i < INV_LIMB_NUM; i++) {
+		d[i] = e[i] = 0;
+		f[i] = inv_q[i];
+	}
+	e[0] = 1;
+	inv_import(g, z);
+
+	/* we keep f = d*z and g = e*z modulo q until g is zero */
+	for (;;) {
+		for (nz = 0, i = 0; i < INV_LIMB_NUM; i++)
+			nz |= g[i];
+		if (nz == 0)
+			break;
+
+		delta = inv_divsteps(delta, f[0], g[0], t);
+		inv_update_de(d, e, t);
+		inv_update_fg(f, g, t);
+	}
+
+	/* now f = +-1, so z^-1 = +-d. bring d from (-2q, q) to [0, q) */
+	if (d[INV_LIMB_NUM-1] < 0) {
+		for (i = 0; i < INV_LIMB_NUM; i++)
+			d[i] += inv_q[i];
+		inv_carry(d);
+	}
+	if (f[INV_LIMB_NUM-1] < 0) {
+		for (i = 0; i < INV_LIMB_NUM; i++)
+			d[i] = -d[i];
+		inv_carry(d);
+	}
+	if (d[INV_LIMB_NUM-1] < 0) {
+		for (i = 0; i < INV_LIMB_NUM; i++)
+			d[i] += inv_q[i];
+		inv_carry(d);
+	}
+
+	inv_export(res, d);
+}
+
+
+/*
+ * fld_inv_batch_vartime - like fld_inv_batch, but with fld_inv_vartime,
+ * so only use it on public values.
+ */
+void
+fld_inv_batch_vartime(fld_t res[], fld_t z[], int n)
+{
+	inv_batch(res, z, n, fld_inv_vartime);
 }
 
 
@@ -657,53 +1102,10 @@ fld_inv(fld_t res, const fld_t z)
 void
 fld_pow2523(fld_t res, const fld_t z)
 {
-        fld_t z2;
-        fld_t z9;
-        fld_t z2_5_0;
-        fld_t z2_10_0;
-        fld_t z2_20_0;
-        fld_t z2_50_0;
-        fld_t z2_100_0;
-        fld_t t;
-        int i;
-                
-        /* 2 */ fld_sq(z2, z);
-        /* 4 */ fld_sq(t, z2);
-        /* 8 */ fld_sq(t, t);
-        /* 9 */ fld_mul(z9, t, z);
-        /* 11 */ fld_mul(t, z9, z2);
-        /* 22 */ fld_sq(t, t);
-        /* 2^5 - 2^0 = 31 */ fld_mul(z2_5_0, t, z9);
-
-        /* 2^6 - 2^1 */ fld_sq(t, z2_5_0);
-        /* 2^10 - 2^5 */ for (i = 1;i < 5;i++) { fld_sq(t, t); }
-        /* 2^10 - 2^0 */ fld_mul(z2_10_0, t, z2_5_0);
-
-        /* 2^11 - 2^1 */ fld_sq(t, z2_10_0);
-        /* 2^20 - 2^10 */ for (i = 1;i < 10;i++) { fld_sq(t, t); }
-        /* 2^20 - 2^0 */ fld_mul(z2_20_0, t, z2_10_0);
-
-        /* 2^21 - 2^1 */ fld_sq(t, z2_20_0);
-        /* 2^40 - 2^20 */ for (i = 1;i < 20;i++) { fld_sq(t, t); }
-        /* 2^40 - 2^0 */ fld_mul(t, t, z2_20_0);
-
-        /* 2^41 - 2^1 */ fld_sq(t, t);
-        /* 2^50 - 2^10 */ for (i = 1;i < 10;i++) { fld_sq(t, t); }
-        /* 2^50 - 2^0 */ fld_mul(z2_50_0, t, z2_10_0);
-
-        /* 2^51 - 2^1 */ fld_sq(t, z2_50_0);
-        /* 2^100 - 2^50 */ for (i = 1;i < 50;i++) { fld_sq(t, t); }
-        /* 2^100 - 2^0 */ fld_mul(z2_100_0, t, z2_50_0);
-
-        /* 2^101 - 2^1 */ fld_sq(t, z2_100_0);
-        /* 2^200 - 2^100 */ for (i = 1;i < 100;i++) { fld_sq(t, t); }
-        /* 2^200 - 2^0 */ fld_mul(t, t, z2_100_0);
-
-        /* 2^201 - 2^1 */ fld_sq(t, t);
-        /* 2^250 - 2^50 */ for (i = 1;i < 50;i++) { fld_sq(t, t); }
-        /* 2^250 - 2^0 */ fld_mul(t, t, z2_50_0);
-
-        /* 2^251 - 2^1 */ fld_sq(t, t);
-        /* 2^252 - 2^2 */ fld_sq(t, t);
-        /* 2^252 - 3 */ fld_mul(res, t, z);
+	fld_t z11;
+	fld_t t;
+
+	/* 2^250 - 2^0 */ fld_pow22501(t, z11, z);
+	/* 2^252 - 2^2 */ fld_sqn(t, t, 2);
+	/* 2^252 - 3 */ fld_mul(res, t, z);
 }
@@ -66,6 +66,7 @@ void	fld_export(uint8_t dst[32], const fld_t src);
 void	fld_mul(fld_t res, const fld_t a, const fld_t b);
 void	fld_scale(fld_t dst, const fld_t src, limb_t x);
 void	fld_sq(fld_t res, const fld_t a);
+void	fld_sqn(fld_t res, const fld_t a, int n);
 
 
 /*
@@ -73,6 +74,9 @@ void	fld_sq(fld_t res, const fld_t a);
  */
 int	fld_eq(const fld_t a, const fld_t b);
 void	fld_inv(fld_t res, const fld_t z);
+void	fld_inv_batch(fld_t res[], fld_t z[], int n);
+void	fld_inv_vartime(fld_t res, const fld_t z);
+void	fld_inv_batch_vartime(fld_t res[], fld_t z[], int n);
 void	fld_pow2523(fld_t res, const fld_t z);
 
 
@@ -107,6 +111,22 @@ fld_sub(fld_t res, const fld_t a, const fld_t b)
 		res[i] = a[i] - b[i];
 }
 
+/*
+ * fld_cswap swaps a and b if mask is -1 and does nothing if mask is 0,
+ * in a time-constant manner.
+ */
+static INLINE void
+fld_cswap(fld_t a, fld_t b, limb_t mask)
+{
+	limb_t t;
+	int i;
+	for (i = 0; i < FLD_LIMB_NUM; i++) {
+		t = (a[i] ^ b[i]) & mask;
+		a[i] ^= t;
+		b[i] ^= t;
+	}
+}
+
 /*
  * fld_tinyscale scales an element a without reducing it. this could
  * be used for conditionally change sign of an element.
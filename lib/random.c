@@ -0,0 +1,53 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "random.h"
+
+
+/*
+ * random_read - fill buf with len random bytes from fd, which should be
+ * opened on /dev/urandom.
+ */
+int
+random_read(int fd, uint8_t *buf, size_t len)
+{
+	ssize_t r;
+
+	while (len > 0) {
+		r = read(fd, buf, len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+
+		buf += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+
+/*
+ * random_get - fill buf with len random bytes, opening /dev/urandom just
+ * for this call.
+ */
+int
+random_get(uint8_t *buf, size_t len)
+{
+	int fd, res;
+
+	fd = open("/dev/urandom", O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	res = random_read(fd, buf, len);
+	close(fd);
+
+	return res;
+}
@@ -0,0 +1,18 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * random bytes from /dev/urandom for the pool and the cache.
+ *
+ * both return 0 on success and -1 if not all len bytes could be read.
+ */
+
+int	random_read(int fd, uint8_t *buf, size_t len);
+int	random_get(uint8_t *buf, size_t len);
+
+
+#endif
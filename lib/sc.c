@@ -16,6 +16,7 @@
 
 #include "bitness.h"
 #include "compat.h"
+#include "burn.h"
 #include "sc.h"
 
 
@@ -76,7 +77,7 @@ const sc_t con_off = { 14280992, 22801768, 35478655, 38650670, 65114297,
  * conditionally subtract m from the result.
  *
  */
-static void
+void
 sc_barrett(sc_t res, const lsc_t x)
 {
 	llimb_t carry;
@@ -155,6 +156,9 @@ sc_barrett(sc_t res, const lsc_t x)
 	 */
 	for (i = 0; i < K; i++)
 		res[i] = r[i];
+
+	burnlocal(q);
+	burnlocal(r);
 }
 
 
@@ -179,6 +183,7 @@ sc_reduce(sc_t dst, const sc_t e)
 	
 	/* reduce modulo m */
 	sc_barrett(dst, tmp);
+	burnlocal(tmp);
 }
 
 /*
@@ -211,6 +216,7 @@ sc_import(sc_t dst, const uint8_t *src, size_t len)
 	}
 
 	sc_barrett(dst, tmp);
+	burnlocal(tmp);
 }
 
 
@@ -233,6 +239,8 @@ sc_export(uint8_t dst[32], const sc_t x)
 		for (fill += LB; fill >= 8 && dst < endp; fill -= 8, foo >>= 8)
 			*dst++ = foo & 0xff;
 	}
+
+	burnlocal(tmp);
 }
 
 /*
@@ -263,6 +271,7 @@ sc_mul(sc_t res, const sc_t a, const sc_t b)
 	tmp[k] = carry >>= LB;
 
 	sc_barrett(res, tmp);
+	burnlocal(tmp);
 }
 
 
@@ -295,7 +304,7 @@ jsfdigit(unsigned int a, unsigned int b)
  * or -1 in case u0 and u1 are all zero.
  */
 int
-sc_jsf(int u0[SC_BITS+1], int u1[SC_BITS+1], const sc_t a, const sc_t b)
+sc_jsf(int8_t u0[SC_BITS+1], int8_t u1[SC_BITS+1], const sc_t a, const sc_t b)
 {
 	limb_t n0, n1;
 	int i, j, k;
@@ -322,3 +331,88 @@ sc_jsf(int u0[SC_BITS+1], int u1[SC_BITS+1], const sc_t a, const sc_t b)
 
 	return k;
 }
+
+
+/*
+ * sc_wnaf - calculate the width-w non-adjacent form of a, ie. digits
+ * u[k] which are zero or odd with |u[k]| < 2^(w-1) and at most one of
+ * w consecutive digits is non-zero. (vartime)
+ *
+ * assumes:
+ *  a carried and reduced
+ *  2 <= w <= 7
+ *
+ * returns the highest index k >= 0 with u[k] != 0 or -1 if a is zero.
+ */
+int
+sc_wnaf(int8_t u[SC_BITS+1], const sc_t a, int w)
+{
+	limb_t n, d;
+	int i, j, k;
+
+	k = n = 0;
+
+	for (i = 0; i < K; i++) {
+		n += a[i];
+
+		for (j = 0; j < LB; j++, k++) {
+			d = 0;
+			if (n & 1) {
+				d = n & ((1 << w) - 1);
+				if (d >= (1 << (w-1)))
+					d -= 1 << w;
+			}
+
+			u[k] = d;
+			n = (n - d) >> 1;
+		}
+	}
+	u[k] = n;
+
+	while (k >= 0 && u[k] == 0)
+		k--;
+
+	return k;
+}
+
+
+/*
+ * sc_radix - calculate the signed radix 2^w digits of a, ie.
+ * a = sum u[k] * 2^(w*k) with -2^(w-1) <= u[k] < 2^(w-1). (vartime)
+ *
+ * assumes:
+ *  a carried and reduced
+ *  4 <= w <= 16
+ *  u has room for SC_RADIX_DIGITS(w) digits
+ *
+ * returns the number of digits, SC_RADIX_DIGITS(w).
+ */
+int
+sc_radix(int16_t u[], const sc_t a, int w)
+{
+	uint8_t pack[32];
+	uint32_t v;
+	int i, k, n, pos, d, carry;
+
+	sc_export(pack, a);
+
+	n = SC_RADIX_DIGITS(w);
+	carry = 0;
+
+	for (i = 0; i < n; i++) {
+		/* v <- the three bytes holding bits pos, ..., pos+w-1 */
+		pos = w * i;
+		v = 0;
+		for (k = 2; k >= 0; k--) {
+			v <<= 8;
+			if ((pos >> 3) + k < 32)
+				v |= pack[(pos >> 3) + k];
+		}
+
+		d = ((v >> (pos & 7)) & ((1 << w) - 1)) + carry;
+		carry = (d >= (1 << (w-1)));
+		u[i] = d - (carry << w);
+	}
+
+	return n;
+}
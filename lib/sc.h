@@ -31,6 +31,9 @@ extern "C" {
 
 #define SC_BITS		(SC_LIMB_NUM * SC_LIMB_BITS)
 
+/* number of signed radix 2^w digits of a reduced scalar, see sc_radix */
+#define SC_RADIX_DIGITS(w)	(253 / (w) + 1)
+
 
 /* sc_t holds 260bit in reduced form */
 typedef limb_t sc_t[SC_LIMB_NUM];
@@ -47,7 +50,11 @@ void	sc_reduce(sc_t dst, const sc_t src);
 void	sc_import(sc_t dst, const uint8_t *src, size_t len);
 void	sc_export(uint8_t dst[32], const sc_t x);
 void	sc_mul(sc_t res, const sc_t a, const sc_t b);
-int	sc_jsf(int u0[SC_BITS+1], int u1[SC_BITS+1], const sc_t a, const sc_t b);
+void	sc_barrett(sc_t res, const lsc_t x);
+int	sc_jsf(int8_t u0[SC_BITS+1], int8_t u1[SC_BITS+1], const sc_t a,
+	       const sc_t b);
+int	sc_wnaf(int8_t u[SC_BITS+1], const sc_t a, int w);
+int	sc_radix(int16_t u[], const sc_t a, int w);
 
 
 static INLINE void
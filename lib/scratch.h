@@ -0,0 +1,35 @@
+#ifndef SCRATCH_H
+#define SCRATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compat.h"
+
+/*
+ * carving of the memory the caller provides (aligned for uint64_t) into
+ * the arrays of the batch functions and contexts.
+ *
+ * every array is rounded up to 8 bytes, so the next one is aligned for
+ * uint64_t again. SCRATCH_LEN may be used in constant expressions to
+ * size an arena on the stack.
+ */
+
+#define SCRATCH_LEN(len)	(((size_t)(len) + 7) & ~(size_t)7)
+
+
+/*
+ * scratch_take - returns len bytes of the memory at *mem and moves *mem
+ * behind them.
+ */
+static INLINE void *
+scratch_take(uint8_t **mem, size_t len)
+{
+	void *p = *mem;
+
+	*mem += SCRATCH_LEN(len);
+
+	return p;
+}
+
+#endif
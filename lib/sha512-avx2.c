@@ -0,0 +1,167 @@
+/*
+ * multi-buffer sha512 using avx2.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * sha512_multi4_avx2 hashes four independent messages, one in each
+ * 64bit lane of the avx2 registers, see sha512-lanes.h.
+ *
+ * sha512_compress_blocks_avx2 is a single-stream compress, which calculates the
+ * message schedule two words at a time in 128bit registers and keeps
+ * only the last 16 words. The rounds stay scalar but use the
+ * non-destructive rorx rotates of bmi2.
+ *
+ * This file must be compiled with avx2 and bmi2 enabled and the caller
+ * has to check for support of the cpu at runtime (see cpu.h).
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "compat.h"
+#include "sha512-avx2.h"
+
+
+#define LANES		4
+
+typedef uint64_t vec_t __attribute__((vector_size(32)));
+
+#include "sha512-lanes.h"
+
+
+typedef uint64_t v2_t __attribute__((vector_size(16)));
+
+/* (W[i+1], W[i+2]) from (W[i], W[i+1]) in lo and (W[i+2], W[i+3]) in hi */
+#define ALIGNR(hi, lo)							\
+	((v2_t)_mm_alignr_epi8((__m128i)(hi), (__m128i)(lo), 8))
+
+/* byte order of the 64bit words */
+#define BSWAP(x)							\
+	((v2_t)_mm_shuffle_epi8((__m128i)(x),				\
+		_mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15,		\
+			     0, 1, 2, 3, 4, 5, 6, 7)))
+
+#define ROR(x, n)	( ((x) >> (n)) | ((x) << (64-(n))) )
+#define S0(x)		(ROR(x, 28) ^ ROR(x, 34) ^ ROR(x, 39))
+#define S1(x)		(ROR(x, 14) ^ ROR(x, 18) ^ ROR(x, 41))
+#define G0(x)		(ROR(x, 1) ^ ROR(x, 8) ^ (x >> 7))
+#define G1(x)		(ROR(x, 19) ^ ROR(x, 61) ^ (x >> 6))
+
+/*
+ * Ch is split into two independent halves (andn), Maj uses
+ *   Maj(a, b, c) = b ^ ((a ^ b) & (b ^ c)),
+ * where b ^ c is a ^ b of the previous round (kept in bc).
+ */
+#define ROUND(i, a,b,c,d,e,f,g,h)					\
+	t = h + S1(e) + (e & f) + (~e & g) + WK[i];			\
+	d += t;								\
+	ab = a ^ b;							\
+	h  = t + S0(a) + (b ^ (ab & bc));				\
+	bc = ab
+
+
+/*
+ * schedule - replaces the 16 words of X by the next 16 words of the
+ * message schedule, two at a time.
+ */
+static INLINE void
+schedule(v2_t X[8])
+{
+	v2_t w15, w7;
+	int j;
+
+	for (j = 0; j < 8; j++) {
+		/* W[i-15, i-14] and W[i-7, i-6] */
+		w15 = ALIGNR(X[(j+1) & 7], X[j]);
+		w7 = ALIGNR(X[(j+5) & 7], X[(j+4) & 7]);
+
+		/* W[i-2, i-1] is in X[j-1] */
+		X[j] += G0(w15) + w7 + G1(X[(j+7) & 7]);
+	}
+}
+
+
+/*
+ * sha512_compress_blocks_avx2 - compresses nblocks blocks into state,
+ * like compress_blocks in sha512.c.
+ */
+void
+sha512_compress_blocks_avx2(uint64_t state[8], const uint8_t *data,
+			    size_t nblocks)
+{
+	v2_t X[8], K;
+	uint64_t WK[16], t, ab, bc;
+	uint64_t a, b, c, d, e, f, g, h;
+	int i, j;
+
+	for (; nblocks > 0; nblocks--, data += SHA512_BLOCK_SIZE) {
+		for (j = 0; j < 8; j++)
+			X[j] = BSWAP(_mm_loadu_si128(
+					(const __m128i *)(data + 16*j)));
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		bc = b ^ c;
+#pragma GCC unroll 5
+		for (i = 0; i < 80; i += 16) {
+			for (j = 0; j < 8; j++) {
+				memcpy(&K, &sha512_round_key[i + 2*j], sizeof(K));
+				K += X[j];
+				memcpy(&WK[2*j], &K, sizeof(K));
+			}
+
+			/* the next words are independent from the rounds below */
+			if (i < 64)
+				schedule(X);
+
+			ROUND( 0, a,b,c,d,e,f,g,h);
+			ROUND( 1, h,a,b,c,d,e,f,g);
+			ROUND( 2, g,h,a,b,c,d,e,f);
+			ROUND( 3, f,g,h,a,b,c,d,e);
+			ROUND( 4, e,f,g,h,a,b,c,d);
+			ROUND( 5, d,e,f,g,h,a,b,c);
+			ROUND( 6, c,d,e,f,g,h,a,b);
+			ROUND( 7, b,c,d,e,f,g,h,a);
+			ROUND( 8, a,b,c,d,e,f,g,h);
+			ROUND( 9, h,a,b,c,d,e,f,g);
+			ROUND(10, g,h,a,b,c,d,e,f);
+			ROUND(11, f,g,h,a,b,c,d,e);
+			ROUND(12, e,f,g,h,a,b,c,d);
+			ROUND(13, d,e,f,g,h,a,b,c);
+			ROUND(14, c,d,e,f,g,h,a,b);
+			ROUND(15, b,c,d,e,f,g,h,a);
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+
+/*
+ * sha512_multi4_avx2 - finishes n <= 4 hashes in parallel, see
+ * sha512_multi.
+ */
+void
+sha512_multi4_avx2(int n, uint8_t *out, const struct sha512 *ctx[],
+		   const uint8_t *data[], const size_t len[])
+{
+	sha512_lanes(n, out, ctx, data, len);
+}
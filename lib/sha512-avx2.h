@@ -0,0 +1,15 @@
+#ifndef SHA512_AVX2_H
+#define SHA512_AVX2_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sha512.h"
+
+
+void	sha512_compress_blocks_avx2(uint64_t state[8], const uint8_t *data,
+				    size_t nblocks);
+void	sha512_multi4_avx2(int n, uint8_t *out, const struct sha512 *ctx[],
+			   const uint8_t *data[], const size_t len[]);
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ * multi-buffer sha512 using avx512.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * sha512_multi8_avx512 hashes eight independent messages, one in each
+ * 64bit lane of the avx512 registers, see sha512-lanes.h.
+ *
+ * This file must be compiled with avx512f enabled and the caller has to
+ * check for avx512f support of the cpu at runtime (see cpu.h).
+ */
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "sha512-avx512.h"
+
+
+#define LANES		8
+
+typedef uint64_t vec_t __attribute__((vector_size(64)));
+
+#include "sha512-lanes.h"
+
+
+/*
+ * sha512_multi8_avx512 - finishes n <= 8 hashes in parallel, see
+ * sha512_multi.
+ */
+void
+sha512_multi8_avx512(int n, uint8_t *out, const struct sha512 *ctx[],
+		     const uint8_t *data[], const size_t len[])
+{
+	sha512_lanes(n, out, ctx, data, len);
+}
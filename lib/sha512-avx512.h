@@ -0,0 +1,13 @@
+#ifndef SHA512_AVX512_H
+#define SHA512_AVX512_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sha512.h"
+
+
+void	sha512_multi8_avx512(int n, uint8_t *out, const struct sha512 *ctx[],
+			     const uint8_t *data[], const size_t len[]);
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * multi-buffer sha512 for the simd code.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * This file is not a normal header: it is included by the simd backends
+ * (sha512-avx2.c, sha512-avx512.c) which have to define
+ *
+ *   LANES	number of 64bit lanes of a vector,
+ *   vec_t	a gcc vector type of LANES uint64_t,
+ *
+ * before including it. All functions are static.
+ *
+ * Every lane hashes its own message. Messages of different length are
+ * handled by masking: once a lane has run out of blocks, it still takes
+ * part in the compression of a dummy block, but its state is kept.
+ */
+
+#ifndef SHA512_LANES_H
+#define SHA512_LANES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sha512.h"
+
+
+#define SPLAT(x)	((vec_t){ 0 } + (uint64_t)(x))
+
+#define VROR(x, n)	( ((x) >> (n)) | ((x) << (64-(n))) )
+#define VS0(x)		(VROR(x, 28) ^ VROR(x, 34) ^ VROR(x, 39))
+#define VS1(x)		(VROR(x, 14) ^ VROR(x, 18) ^ VROR(x, 41))
+#define VG0(x)		(VROR(x, 1) ^ VROR(x, 8) ^ (x >> 7))
+#define VG1(x)		(VROR(x, 19) ^ VROR(x, 61) ^ (x >> 6))
+
+
+/* W only keeps the last 16 words of the message schedule */
+#define VSCHED(i)							\
+	W[i] += VG0(W[((i)+1) & 15]) + W[((i)+9) & 15] + VG1(W[((i)+14) & 15])
+
+#define VROUND(i, a,b,c,d,e,f,g,h)					\
+	t = h + VS1(e) + (g ^ (e & (f ^ g))) + 				\
+		SPLAT(sha512_round_key[i]) + W[(i) & 15];		\
+	d += t;								\
+	h  = t + VS0(a) + ( ((a | b) & c) | (a & b) )
+
+
+/*
+ * the blocks of a lane: an optional first block made of the buffered
+ * bytes of the context and the start of the data, the full blocks of
+ * the data and one or two final blocks with the rest and the padding.
+ */
+struct sha512_lane {
+	const uint8_t	*data;
+	size_t		nfull;
+	size_t		nblocks;
+	int		has_first;
+
+	uint8_t		first[SHA512_BLOCK_SIZE];
+	uint8_t		last[2*SHA512_BLOCK_SIZE];
+};
+
+
+/*
+ * lane_setup - splits the remaining message of ctx plus len bytes of
+ * data into blocks, see struct sha512_lane. if ctx is NULL a fresh
+ * context is used.
+ */
+static void
+lane_setup(struct sha512_lane *l, const struct sha512 *ctx,
+	   const uint8_t *data, size_t len)
+{
+	uint64_t count = 0, bits;
+	size_t fill = 0, take, nlast;
+	int i;
+
+	if (ctx != NULL) {
+		fill = ctx->fill;
+		count = ctx->count;
+	}
+
+	l->has_first = 0;
+	if (fill > 0) {
+		take = SHA512_BLOCK_SIZE - fill;
+		if (take > len)
+			take = len;
+
+		memcpy(l->first, ctx->buffer, fill);
+		memcpy(l->first + fill, data, take);
+		data += take;
+		len -= take;
+		fill += take;
+
+		if (fill == SHA512_BLOCK_SIZE) {
+			l->has_first = 1;
+			count++;
+			fill = 0;
+		}
+	}
+
+	l->data = data;
+	l->nfull = len / SHA512_BLOCK_SIZE;
+	count += l->nfull;
+
+	/* the rest goes to the final blocks, like in sha512_final */
+	if (fill > 0)
+		memcpy(l->last, l->first, fill);
+	else {
+		fill = len % SHA512_BLOCK_SIZE;
+		memcpy(l->last, data + l->nfull * SHA512_BLOCK_SIZE, fill);
+	}
+
+	nlast = (fill + 1 > SHA512_BLOCK_SIZE - 16) ? 2 : 1;
+
+	l->last[fill] = 0x80;
+	memset(l->last + fill + 1, 0, nlast * SHA512_BLOCK_SIZE - fill - 1);
+
+	bits = ((count << 7) | fill) << 3;
+	for (i = 0; i < 8; i++) {
+		l->last[nlast * SHA512_BLOCK_SIZE - 16 + i] =
+			(count >> 54) >> (56 - 8*i);
+		l->last[nlast * SHA512_BLOCK_SIZE - 8 + i] =
+			bits >> (56 - 8*i);
+	}
+
+	l->nblocks = l->has_first + l->nfull + nlast;
+}
+
+
+/*
+ * lane_block - returns the k-th block of the lane.
+ */
+static const uint8_t *
+lane_block(const struct sha512_lane *l, size_t k)
+{
+	if (l->has_first) {
+		if (k == 0)
+			return l->first;
+		k--;
+	}
+
+	if (k < l->nfull)
+		return l->data + k * SHA512_BLOCK_SIZE;
+
+	return l->last + (k - l->nfull) * SHA512_BLOCK_SIZE;
+}
+
+
+/*
+ * compress_lanes - compresses one block per lane into state, lanes with
+ * active cleared keep their state.
+ */
+static void
+compress_lanes(vec_t state[8], const uint8_t *block[LANES], vec_t active)
+{
+	vec_t W[16], t;
+	vec_t a, b, c, d, e, f, g, h;
+	uint64_t x;
+	int i, k;
+
+	for (i = 0; i < 16; i++) {
+		for (k = 0; k < LANES; k++) {
+			memcpy(&x, block[k] + 8*i, 8);
+			W[i][k] = __builtin_bswap64(x);
+		}
+	}
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	for (i = 0; i < 16; i += 8) {
+		VROUND(i+0, a,b,c,d,e,f,g,h);
+		VROUND(i+1, h,a,b,c,d,e,f,g);
+		VROUND(i+2, g,h,a,b,c,d,e,f);
+		VROUND(i+3, f,g,h,a,b,c,d,e);
+		VROUND(i+4, e,f,g,h,a,b,c,d);
+		VROUND(i+5, d,e,f,g,h,a,b,c);
+		VROUND(i+6, c,d,e,f,g,h,a,b);
+		VROUND(i+7, b,c,d,e,f,g,h,a);
+	}
+
+	/* from now on every round replaces W[i-16] by W[i] first */
+	for (; i < 80; i += 8) {
+		VSCHED((i+0) & 15); VROUND(i+0, a,b,c,d,e,f,g,h);
+		VSCHED((i+1) & 15); VROUND(i+1, h,a,b,c,d,e,f,g);
+		VSCHED((i+2) & 15); VROUND(i+2, g,h,a,b,c,d,e,f);
+		VSCHED((i+3) & 15); VROUND(i+3, f,g,h,a,b,c,d,e);
+		VSCHED((i+4) & 15); VROUND(i+4, e,f,g,h,a,b,c,d);
+		VSCHED((i+5) & 15); VROUND(i+5, d,e,f,g,h,a,b,c);
+		VSCHED((i+6) & 15); VROUND(i+6, c,d,e,f,g,h,a,b);
+		VSCHED((i+7) & 15); VROUND(i+7, b,c,d,e,f,g,h,a);
+	}
+
+	state[0] += a & active;
+	state[1] += b & active;
+	state[2] += c & active;
+	state[3] += d & active;
+	state[4] += e & active;
+	state[5] += f & active;
+	state[6] += g & active;
+	state[7] += h & active;
+}
+
+
+/*
+ * sha512_lanes - finishes n <= LANES hashes in parallel, see sha512_multi.
+ */
+static void
+sha512_lanes(int n, uint8_t *out, const struct sha512 *ctx[],
+	     const uint8_t *data[], const size_t len[])
+{
+	static const uint8_t dummy[SHA512_BLOCK_SIZE];
+	struct sha512_lane lane[LANES];
+	const uint8_t *block[LANES];
+	struct sha512 init;
+	vec_t state[8], active;
+	size_t k, nblocks;
+	int i, j;
+
+	sha512_init(&init);
+
+	nblocks = 0;
+	for (j = 0; j < LANES; j++) {
+		if (j < n) {
+			lane_setup(&lane[j], ctx ? ctx[j] : NULL, data[j],
+				   len[j]);
+			if (lane[j].nblocks > nblocks)
+				nblocks = lane[j].nblocks;
+		} else
+			lane[j].nblocks = 0;
+
+		for (i = 0; i < 8; i++)
+			state[i][j] = (ctx && j < n) ? ctx[j]->state[i]
+						     : init.state[i];
+	}
+
+	for (k = 0; k < nblocks; k++) {
+		active = SPLAT(0);
+		for (j = 0; j < LANES; j++) {
+			if (k < lane[j].nblocks) {
+				block[j] = lane_block(&lane[j], k);
+				active[j] = -(uint64_t)1;
+			} else
+				block[j] = dummy;
+		}
+
+		compress_lanes(state, block, active);
+	}
+
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < 8; i++) {
+			for (k = 0; k < 8; k++)
+				out[SHA512_HASH_LENGTH*j + 8*i + k] =
+					state[i][j] >> (56 - 8*k);
+		}
+	}
+}
+
+#endif
@@ -11,9 +11,21 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "compat.h"
 #include "sha512.h"
+#include "burn.h"
+#include "cpu.h"
 
-static const uint64_t round_key[80] = {
+#ifdef USE_AVX2
+#include "sha512-avx2.h"
+#endif
+
+#ifdef USE_AVX512
+#include "sha512-avx512.h"
+#endif
+
+
+const uint64_t sha512_round_key[80] = {
 	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
 	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
 	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
@@ -52,7 +64,7 @@ static const uint64_t round_key[80] = {
 
 
 #define ROUND(i, a,b,c,d,e,f,g,h)				\
-     t = h + S1(e) + (g ^ (e & (f ^ g))) + round_key[i] + W[i];	\
+     t = h + S1(e) + (g ^ (e & (f ^ g))) + sha512_round_key[i] + W[i];	\
      d += t;							\
      h  = t + S0(a) + ( ((a | b) & c) | (a & b) )
 
@@ -81,46 +93,90 @@ load_be64(const uint8_t *p)
 
 
 static void
-compress(uint64_t state[8], const uint8_t buf[SHA512_BLOCK_SIZE])
+compress_generic(uint64_t state[8], const uint8_t *data, size_t nblocks)
 {
 	uint64_t W[80], t;
 	uint64_t a, b, c, d, e, f, g, h;
 	int i;
 
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-	f = state[5];
-	g = state[6];
-	h = state[7];
-
-	for (i = 0; i < 16; i++)
-		W[i] = load_be64(buf+8*i);
-
-	for (i = 16; i < 80; i++)
-		W[i] = W[i-16] + G0(W[i-15]) + W[i-7] + G1(W[i-2]);
-
-	for (i = 0; i < 80; i += 8) {
-		ROUND(i+0, a,b,c,d,e,f,g,h);
-		ROUND(i+1, h,a,b,c,d,e,f,g);
-		ROUND(i+2, g,h,a,b,c,d,e,f);
-		ROUND(i+3, f,g,h,a,b,c,d,e);
-		ROUND(i+4, e,f,g,h,a,b,c,d);
-		ROUND(i+5, d,e,f,g,h,a,b,c);
-		ROUND(i+6, c,d,e,f,g,h,a,b);
-		ROUND(i+7, b,c,d,e,f,g,h,a);
+	for (; nblocks > 0; nblocks--, data += SHA512_BLOCK_SIZE) {
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		for (i = 0; i < 16; i++)
+			W[i] = load_be64(data+8*i);
+
+		for (i = 16; i < 80; i++)
+			W[i] = W[i-16] + G0(W[i-15]) + W[i-7] + G1(W[i-2]);
+
+		for (i = 0; i < 80; i += 8) {
+			ROUND(i+0, a,b,c,d,e,f,g,h);
+			ROUND(i+1, h,a,b,c,d,e,f,g);
+			ROUND(i+2, g,h,a,b,c,d,e,f);
+			ROUND(i+3, f,g,h,a,b,c,d,e);
+			ROUND(i+4, e,f,g,h,a,b,c,d);
+			ROUND(i+5, d,e,f,g,h,a,b,c);
+			ROUND(i+6, c,d,e,f,g,h,a,b);
+			ROUND(i+7, b,c,d,e,f,g,h,a);
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
 	}
+}
 
-	state[0] += a;
-	state[1] += b;
-	state[2] += c;
-	state[3] += d;
-	state[4] += e;
-	state[5] += f;
-	state[6] += g;
-	state[7] += h;
+
+#ifdef USE_PRECISE_CLEAN
+
+/* more than the stack frame of any compress function */
+#define COMPRESS_STACK	1024
+
+/*
+ * burn_compress - cleanup the stack frame of the last compress function.
+ *
+ * the compress functions keep the state in registers, which are spilled
+ * to their frame, so it is not enough to wipe their local variables.
+ */
+static NOINLINE void
+burn_compress(void)
+{
+	uint8_t stack[COMPRESS_STACK];
+
+	burn(stack, sizeof(stack));
+}
+
+#endif
+
+
+/*
+ * compress_blocks - compresses nblocks consecutive blocks of data into
+ * state, with avx2 and bmi2 if the cpu supports them.
+ */
+static void
+compress_blocks(uint64_t state[8], const uint8_t *data, size_t nblocks)
+{
+#ifdef USE_AVX2
+	if (cpu_has_avx2() && cpu_has_bmi2()) {
+		sha512_compress_blocks_avx2(state, data, nblocks);
+	} else
+#endif
+	compress_generic(state, data, nblocks);
+
+#ifdef USE_PRECISE_CLEAN
+	burn_compress();
+#endif
 }
 
 
@@ -143,27 +199,34 @@ sha512_init(struct sha512 *ctx)
 void
 sha512_add(struct sha512 *ctx, const uint8_t *data, size_t len)
 {
+	size_t n;
+
 	if (ctx->fill > 0) {
 		/* fill internal buffer up and compress */
-		while (ctx->fill < SHA512_BLOCK_SIZE && len > 0) {
-			ctx->buffer[ctx->fill++] = *data++;
-			len--;
-		}
+		n = SHA512_BLOCK_SIZE - ctx->fill;
+		if (n > len)
+			n = len;
+
+		memcpy(ctx->buffer + ctx->fill, data, n);
+		ctx->fill += n;
+		data += n;
+		len -= n;
+
 		if (ctx->fill < SHA512_BLOCK_SIZE)
 			return;
 
-		compress(ctx->state, ctx->buffer);
+		compress_blocks(ctx->state, ctx->buffer, 1);
 		ctx->count++;
 	}
 
-	/* ctx->fill is now zero */
+	/* ctx->fill is now zero, compress all full blocks in place */
+	n = len / SHA512_BLOCK_SIZE;
+	if (n > 0) {
+		compress_blocks(ctx->state, data, n);
+		ctx->count += n;
 
-	while (len >= SHA512_BLOCK_SIZE) {
-		compress(ctx->state, data);
-		ctx->count++;
-		
-		data += SHA512_BLOCK_SIZE;
-		len -= SHA512_BLOCK_SIZE;
+		data += n * SHA512_BLOCK_SIZE;
+		len -= n * SHA512_BLOCK_SIZE;
 	}
 
 	/* save rest for next time */
@@ -187,7 +250,7 @@ sha512_final(struct sha512 *ctx, uint8_t out[SHA512_HASH_LENGTH])
 		while (ctx->fill < SHA512_BLOCK_SIZE)
 			ctx->buffer[ctx->fill++] = 0;
 
-		compress(ctx->state, ctx->buffer);
+		compress_blocks(ctx->state, ctx->buffer, 1);
 		ctx->fill = 0;
 	}
 	while (ctx->fill < SHA512_BLOCK_SIZE - 16)
@@ -202,9 +265,64 @@ sha512_final(struct sha512 *ctx, uint8_t out[SHA512_HASH_LENGTH])
 	store_be64(ctx->buffer+SHA512_BLOCK_SIZE-8,
 			((ctx->count << 7) | rest) << 3);
 	
-	compress(ctx->state, ctx->buffer);
+	compress_blocks(ctx->state, ctx->buffer, 1);
 
 
 	for (i = 0; i < 8; i++)
 		store_be64(out + 8*i, ctx->state[i]);
 }
+
+
+/*
+ * sha512_multi - finishes n hashes, where the i-th hash covers the data
+ * already added to ctx[i] followed by len[i] bytes of data[i]. if ctx
+ * is NULL the hashes start from scratch. the contexts are not modified
+ * and the hashes are written to out, which holds n * SHA512_HASH_LENGTH
+ * bytes.
+ *
+ * with avx2 (avx512) four (eight) hashes are calculated in parallel.
+ * sha512-avx2.c is built with bmi2 as well, so it needs both.
+ */
+void
+sha512_multi(size_t n, uint8_t *out, const struct sha512 *ctx[],
+	     const uint8_t *data[], const size_t len[])
+{
+	struct sha512 tmp;
+	size_t i = 0;
+
+#ifdef USE_AVX512
+	if (cpu_has_avx512f()) {
+		int m;
+
+		for (; n - i > 4; i += m) {
+			m = (n - i < 8) ? (int)(n - i) : 8;
+			sha512_multi8_avx512(m, out + i*SHA512_HASH_LENGTH,
+					     ctx ? ctx + i : NULL,
+					     data + i, len + i);
+		}
+	}
+#endif
+#ifdef USE_AVX2
+	if (cpu_has_avx2() && cpu_has_bmi2()) {
+		int m;
+
+		for (; n - i > 1; i += m) {
+			m = (n - i < 4) ? (int)(n - i) : 4;
+			sha512_multi4_avx2(m, out + i*SHA512_HASH_LENGTH,
+					   ctx ? ctx + i : NULL,
+					   data + i, len + i);
+		}
+	}
+#endif
+
+	/* the remaining ones are done one by one */
+	for (; i < n; i++) {
+		if (ctx)
+			memcpy(&tmp, ctx[i], sizeof(struct sha512));
+		else
+			sha512_init(&tmp);
+
+		sha512_add(&tmp, data[i], len[i]);
+		sha512_final(&tmp, out + i*SHA512_HASH_LENGTH);
+	}
+}
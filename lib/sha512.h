@@ -24,6 +24,12 @@ void sha512_init(struct sha512 *ctx);
 void sha512_add(struct sha512 *ctx, const uint8_t *data, size_t len);
 void sha512_final(struct sha512 *ctx, uint8_t out[SHA512_HASH_LENGTH]);
 
+void sha512_multi(size_t n, uint8_t *out, const struct sha512 *ctx[],
+		  const uint8_t *data[], const size_t len[]);
+
+/* round constants, shared with the simd code */
+extern const uint64_t sha512_round_key[80];
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,229 @@
+/*
+ * vectorised montgomery ladders for x25519 using avx2.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * mg_scale_avx2 packs the four coordinates (x2, z2, x3, z3) of a single
+ * ladder into the four 64bit lanes of avx2 registers, so that the
+ * independent field multiplications of one ladder step run in parallel,
+ * similar to the sandy2x ladder.
+ *
+ * mg_scale4_avx2 runs four independent ladders, one in each lane.
+ *
+ * mg_scale_avx2 only beats the 32bit field code, the 64bit scalar ladder
+ * is faster, so it is only built for 32bit (see x25519-avx2.h).
+ *
+ * This file must be compiled with avx2 enabled and the caller has to
+ * check for avx2 support of the cpu at runtime (see cpu.h).
+ */
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "x25519-avx2.h"
+#include "burn.h"
+
+
+#define LANES		4
+
+typedef uint64_t vec_t __attribute__((vector_size(32)));
+
+#define MUL(a, b)	((vec_t)_mm256_mul_epu32((__m256i)(a), (__m256i)(b)))
+
+#include "x25519-lanes.h"
+
+
+#ifdef USE_MG_SCALE_AVX2
+
+/* lane selectors for _mm256_permute4x64_epi64 */
+#define PERM_PAIRSWAP	0xb1		/* (a,b,c,d) -> (b,a,d,c) */
+#define PERM_HALFSWAP	0x4e		/* (a,b,c,d) -> (c,d,a,b) */
+#define PERM_ABDC	0xb4		/* (a,b,c,d) -> (a,b,d,c) */
+#define PERM_ABAB	0x44		/* (a,b,c,d) -> (a,b,a,b) */
+
+#define PERMUTE(a, sel)							\
+	((vec_t)_mm256_permute4x64_epi64((__m256i)(a), (sel)))
+
+/* lane masks for _mm256_blend_epi32 */
+#define LANE0		0x03
+#define LANE1		0x0c
+#define LANE2		0x30
+#define LANE3		0xc0
+
+#define BLEND(a, b, sel)						\
+	((vec_t)_mm256_blend_epi32((__m256i)(a), (__m256i)(b), (sel)))
+
+
+
+/*
+ * fldv_permute - permute the lanes of a, see PERM_* for sel.
+ */
+#define fldv_permute(res, a, sel)					\
+do {									\
+	int _ii;							\
+	for (_ii = 0; _ii < LIMBS; _ii++)				\
+		(res)[_ii] = PERMUTE((a)[_ii], (sel));			\
+} while (0)
+
+
+/*
+ * fldv_blend - take the lanes given by sel (see LANE*) from b and the
+ * others from a.
+ */
+#define fldv_blend(res, a, b, sel)					\
+do {									\
+	int _ii;							\
+	for (_ii = 0; _ii < LIMBS; _ii++)				\
+		(res)[_ii] = BLEND((a)[_ii], (b)[_ii], (sel));		\
+} while (0)
+
+
+/*
+ * fldv_halfswap - swap lanes (0,1) with (2,3) if mask is all ones.
+ */
+static void
+fldv_halfswap(fldv_t a, vec_t mask)
+{
+	vec_t t;
+	int i;
+
+	for (i = 0; i < LIMBS; i++) {
+		t = (a[i] ^ PERMUTE(a[i], PERM_HALFSWAP)) & mask;
+		a[i] ^= t;
+	}
+
+	burnlocal(t);
+}
+
+
+/*
+ * montgomery4 - vectorised version of montgomery() from x25519.c
+ *
+ * input: S = (x2, z2, x3, z3) where (x3, z3) - (x2, z2) has u-coordinate
+ *        x1 and X1 = (1, 1, 1, x1).
+ * output: S <- (2*(x2, z2), (x2, z2) + (x3, z3))
+ */
+static void
+montgomery4(fldv_t S, const fldv_t X1)
+{
+	fldv_t P, T, L, R, U, V;
+
+	/* T <- (A, B, C, D) = (x2 + z2, x2 - z2, x3 + z3, x3 - z3) */
+	fldv_permute(P, S, PERM_PAIRSWAP);
+	fldv_add(T, S, P);
+	fldv_sub(U, P, S);
+	fldv_blend(T, T, U, LANE1 | LANE3);
+
+	/* S <- (AA, BB, DA, CB) */
+	fldv_permute(L, T, PERM_ABDC);
+	fldv_permute(R, T, PERM_ABAB);
+	fldv_mul(S, L, R);
+
+	/* P <- (BB, AA, CB, DA) */
+	fldv_permute(P, S, PERM_PAIRSWAP);
+
+	/* U <- (AA, E, DA + CB, DA - CB) with E = AA - BB */
+	fldv_add(T, S, P);
+	fldv_sub(V, P, S);
+	fldv_blend(U, S, V, LANE1 | LANE3);
+	fldv_blend(U, U, T, LANE2);
+
+	/* R <- (BB, AA + 121665*E, DA + CB, DA - CB) */
+	fldv_scale(V, U, 121665);
+	fldv_add(V, V, P);
+	fldv_blend(R, U, P, LANE0);
+	fldv_blend(R, R, V, LANE1);
+
+	/* S <- (AA*BB, E*(AA + 121665*E), (DA+CB)^2, x1*(DA-CB)^2) */
+	fldv_mul(S, U, R);
+	fldv_mul(S, S, X1);
+
+	burnlocal(P);
+	burnlocal(T);
+	burnlocal(L);
+	burnlocal(R);
+	burnlocal(U);
+	burnlocal(V);
+}
+
+
+/*
+ * mg_scale_avx2 - calculates s * (u : 1) with the vectorised ladder and
+ * returns the result in projective form (x : z).
+ *
+ * s must be clamped, like mg_scale in x25519.c the ladder starts at bit
+ * 253 with ((u : 1), 2*(u : 1)) and finishes with three doublings.
+ */
+void
+mg_scale_avx2(fld_t x, fld_t z, const fld_t u, const uint8_t s[32])
+{
+	fldv_t S, X1;
+	fld_t zero, one;
+	uint64_t bit, swap;
+	int i;
+
+	fld_set0(zero, 0);
+	fld_set0(one, 1);
+
+	fldv_set(X1, 0, one);
+	fldv_set(X1, 1, one);
+	fldv_set(X1, 2, one);
+	fldv_set(X1, 3, u);
+
+	/*
+	 * bit 254 is set: the step from ((u : 1), (1 : 0)) gives
+	 * (2*(u : 1), (u : 1)), ie. ((u : 1), 2*(u : 1)) with a pending
+	 * swap.
+	 */
+	fldv_set(S, 0, u);
+	fldv_set(S, 1, one);
+	fldv_set(S, 2, one);
+	fldv_set(S, 3, zero);
+	montgomery4(S, X1);
+
+	/* one swap per bit, see mg_scale in x25519.c */
+	swap = 1;
+	for (i = 253; i >= 3; i--) {
+		bit = (s[i >> 3] >> (i & 7)) & 1;
+		swap ^= bit;
+		fldv_halfswap(S, SPLAT(-swap));
+		swap = bit;
+
+		montgomery4(S, X1);
+	}
+
+	fldv_halfswap(S, SPLAT(-swap));
+
+	/*
+	 * the lowest three bits are cleared. montgomery4 doubles (x2 : z2)
+	 * in the lower lanes, the upper ones aren't needed anymore.
+	 */
+	montgomery4(S, X1);
+	montgomery4(S, X1);
+	montgomery4(S, X1);
+
+	fldv_get(x, S, 0);
+	fldv_get(z, S, 1);
+
+	burnlocal(S);
+	burnlocal(bit);
+	burnlocal(swap);
+}
+
+
+#endif /* USE_MG_SCALE_AVX2 */
+
+
+/*
+ * mg_scale4_avx2 - calculates s[i] * (u[i] : 1) for i = 0, ..., 3 in
+ * parallel and returns the results in projective form (x[i] : z[i]).
+ */
+void
+mg_scale4_avx2(fld_t x[4], fld_t z[4], fld_t u[4],
+	       uint8_t s[4][32])
+{
+	mg_scale_lanes(x, z, u, s);
+}
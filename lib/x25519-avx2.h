@@ -0,0 +1,24 @@
+#ifndef X25519_AVX2_H
+#define X25519_AVX2_H
+
+#include <stdint.h>
+
+#include "bitness.h"
+#include "fld.h"
+
+
+/*
+ * the vectorised single ladder only pays off against the 32bit field
+ * code, the 64bit scalar ladder is faster than it on current cpus.
+ */
+#ifndef USE_64BIT
+#define USE_MG_SCALE_AVX2
+#endif
+
+#ifdef USE_MG_SCALE_AVX2
+void	mg_scale_avx2(fld_t x, fld_t z, const fld_t u, const uint8_t s[32]);
+#endif
+void	mg_scale4_avx2(fld_t x[4], fld_t z[4], fld_t u[4],
+		       uint8_t s[4][32]);
+
+#endif
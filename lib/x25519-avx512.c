@@ -0,0 +1,41 @@
+/*
+ * vectorised montgomery ladder for x25519 using avx512.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * mg_scale8_avx512 runs eight independent ladders, one in each 64bit
+ * lane of the avx512 registers. The lane arithmetic is shared with the
+ * avx2 code, see x25519-lanes.h.
+ *
+ * This file must be compiled with avx512f enabled and the caller has to
+ * check for avx512f support of the cpu at runtime (see cpu.h).
+ */
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "x25519-avx512.h"
+
+
+#define LANES		8
+
+typedef uint64_t vec_t __attribute__((vector_size(64)));
+
+#define MUL(a, b)	((vec_t)_mm512_mul_epu32((__m512i)(a), (__m512i)(b)))
+
+#include "x25519-lanes.h"
+
+
+/*
+ * mg_scale8_avx512 - calculates s[i] * (u[i] : 1) for i = 0, ..., 7 in
+ * parallel and returns the results in projective form (x[i] : z[i]).
+ */
+void
+mg_scale8_avx512(fld_t x[8], fld_t z[8], fld_t u[8],
+		 uint8_t s[8][32])
+{
+	mg_scale_lanes(x, z, u, s);
+}
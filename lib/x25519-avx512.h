@@ -0,0 +1,12 @@
+#ifndef X25519_AVX512_H
+#define X25519_AVX512_H
+
+#include <stdint.h>
+
+#include "fld.h"
+
+
+void	mg_scale8_avx512(fld_t x[8], fld_t z[8], fld_t u[8],
+			 uint8_t s[8][32]);
+
+#endif
@@ -0,0 +1,406 @@
+/*
+ * lane-wise field arithmetic and montgomery ladder for the simd code.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * This file is not a normal header: it is included by the simd backends
+ * (x25519-avx2.c, x25519-avx512.c) which have to define
+ *
+ *   LANES	number of 64bit lanes of a vector,
+ *   vec_t	a gcc vector type of LANES uint64_t,
+ *   MUL(a, b)	lane-wise multiplication of the low 32bit of a and b
+ *		to 64bit (i.e. vpmuludq),
+ *
+ * before including it. All functions are static.
+ *
+ * Inside a lane a field element uses ten unsigned limbs of alternating
+ * 26 and 25 bits (like the 32bit version of fld_t), so all limb products
+ * fit the 32x32->64bit multiplication.
+ */
+
+#ifndef X25519_LANES_H
+#define X25519_LANES_H
+
+#include <stdint.h>
+
+#include "bitness.h"
+#include "compat.h"
+#include "burn.h"
+#include "fld.h"
+
+
+#define LIMBS		10
+
+#define MASK26		((1 << 26) - 1)
+#define MASK25		((1 << 25) - 1)
+
+#define SPLAT(x)	((vec_t){ 0 } + (uint64_t)(x))
+
+
+/* fldv_t holds LANES field elements, one in each lane */
+typedef vec_t fldv_t[LIMBS];
+
+/*
+ * SETTLE - the products of a row have to be added to the limbs of h
+ * before the next row starts. otherwise gcc keeps up to all 100 products
+ * of fldv_mul in flight and spills them to about 5K of stack.
+ */
+#define SETTLE(h)							\
+	__asm__("" : "+v"(h[0]), "+v"(h[1]), "+v"(h[2]), "+v"(h[3]),	\
+		     "+v"(h[4]), "+v"(h[5]), "+v"(h[6]), "+v"(h[7]),	\
+		     "+v"(h[8]), "+v"(h[9]))
+
+
+
+/*
+ * fldv_set - sets the field element of the given lane to x.
+ */
+static void
+fldv_set(fldv_t res, int lane, const fld_t x)
+{
+	fld_t t;
+	int i;
+
+	fld_reduce(t, x);
+
+#ifdef USE_64BIT
+	for (i = 0; i < FLD_LIMB_NUM; i++) {
+		res[2*i][lane] = t[i] & MASK26;
+		res[2*i+1][lane] = t[i] >> 26;
+	}
+#else
+	for (i = 0; i < FLD_LIMB_NUM; i++)
+		res[i][lane] = t[i];
+#endif
+}
+
+
+/*
+ * fldv_get - extracts the field element of the given lane.
+ *
+ * a has to be carried.
+ */
+static void
+fldv_get(fld_t res, const fldv_t a, int lane)
+{
+	int i;
+
+#ifdef USE_64BIT
+	for (i = 0; i < FLD_LIMB_NUM; i++)
+		res[i] = a[2*i][lane] + (a[2*i+1][lane] << 26);
+#else
+	for (i = 0; i < FLD_LIMB_NUM; i++)
+		res[i] = a[i][lane];
+#endif
+}
+
+
+/*
+ * fldv_carry - carry all limbs of h.
+ *
+ * afterwards all limbs hold at most 26 (resp. 25) bits plus a small
+ * excess in limb 1 and 5.
+ */
+static INLINE void
+fldv_carry(fldv_t h)
+{
+	vec_t c;
+
+#define CARRY(i, bits)							\
+	c = h[i] >> (bits);						\
+	h[i] &= ((uint64_t)1 << (bits)) - 1;				\
+	h[i+1] += c
+
+	/* two interleaved chains 0 -> 5 and 4 -> 9 */
+	CARRY(0, 26);
+	CARRY(4, 26);
+	CARRY(1, 25);
+	CARRY(5, 25);
+	CARRY(2, 26);
+	CARRY(6, 26);
+	CARRY(3, 25);
+	CARRY(7, 25);
+	CARRY(4, 26);
+	CARRY(8, 26);
+
+	/* wrap around with 2^255 = 19 */
+	c = h[9] >> 25;
+	h[9] &= MASK25;
+	h[0] += c + (c << 1) + (c << 4);
+
+	CARRY(0, 26);
+
+#undef CARRY
+}
+
+
+/*
+ * fldv_add - lane-wise addition without carry.
+ */
+static INLINE void
+fldv_add(fldv_t res, const fldv_t a, const fldv_t b)
+{
+	int i;
+	for (i = 0; i < LIMBS; i++)
+		res[i] = a[i] + b[i];
+}
+
+
+/*
+ * fldv_sub - lane-wise subtraction without carry.
+ *
+ * we add 2*q to stay non-negative, so b must be carried.
+ */
+static INLINE void
+fldv_sub(fldv_t res, const fldv_t a, const fldv_t b)
+{
+	int i;
+
+	res[0] = a[0] + 2*(MASK26 - 18) - b[0];
+	for (i = 1; i < LIMBS; i++) {
+		if (i & 1)
+			res[i] = a[i] + 2*MASK25 - b[i];
+		else
+			res[i] = a[i] + 2*MASK26 - b[i];
+	}
+}
+
+
+/*
+ * fldv_mul - lane-wise multiplication modulo q.
+ *
+ * assumes all limbs of a and b are below 2^27.7, so 19*b[i] still
+ * fits into 32bit and the sums of products do not overflow 64bit.
+ */
+static void
+fldv_mul(fldv_t res, const fldv_t a, const fldv_t b)
+{
+	vec_t b19[LIMBS], ai, a2i;
+	fldv_t h;
+	int i, j;
+
+	for (i = 0; i < LIMBS; i++) {
+		b19[i] = MUL(b[i], SPLAT(19));
+		h[i] = SPLAT(0);
+	}
+
+	/*
+	 * accumulate row by row. if i and j are both odd the product
+	 * a[i]*b[j] has to be doubled, to compensate for the alternating
+	 * limb sizes.
+	 */
+#pragma GCC unroll 10
+	for (i = 0; i < LIMBS; i++) {
+		ai = a[i];
+		a2i = (i & 1) ? ai + ai : ai;
+
+#pragma GCC unroll 10
+		for (j = 0; j < LIMBS; j++) {
+			if (i + j < LIMBS)
+				h[i+j] += MUL((j & 1) ? a2i : ai, b[j]);
+			else
+				h[i+j-LIMBS] += MUL((j & 1) ? a2i : ai, b19[j]);
+		}
+		SETTLE(h);
+	}
+
+	fldv_carry(h);
+
+	for (i = 0; i < LIMBS; i++)
+		res[i] = h[i];
+}
+
+
+/*
+ * fldv_sq - lane-wise squaring modulo q.
+ *
+ * like fldv_mul, but every mixed product is only calculated once.
+ */
+static void
+fldv_sq(fldv_t res, const fldv_t a)
+{
+	vec_t a19[LIMBS], ai;
+	fldv_t h;
+	int i, j;
+
+	for (i = 0; i < LIMBS; i++) {
+		a19[i] = MUL(a[i], SPLAT(19));
+		h[i] = SPLAT(0);
+	}
+
+	/*
+	 * the factor of a[i]*a[j] is 2 for i != j and doubles again if
+	 * i and j are both odd. we apply it on a[i], which stays below 2^32.
+	 */
+#pragma GCC unroll 10
+	for (i = 0; i < LIMBS; i++) {
+#pragma GCC unroll 10
+		for (j = i; j < LIMBS; j++) {
+			ai = a[i];
+			if (i != j)
+				ai += ai;
+			if (i & j & 1)
+				ai += ai;
+
+			if (i + j < LIMBS)
+				h[i+j] += MUL(ai, a[j]);
+			else
+				h[i+j-LIMBS] += MUL(ai, a19[j]);
+		}
+		SETTLE(h);
+	}
+
+	fldv_carry(h);
+
+	for (i = 0; i < LIMBS; i++)
+		res[i] = h[i];
+}
+
+
+/*
+ * fldv_scale - lane-wise multiplication with a small constant x < 2^17.
+ */
+static void
+fldv_scale(fldv_t res, const fldv_t a, uint32_t x)
+{
+	int i;
+
+	for (i = 0; i < LIMBS; i++)
+		res[i] = MUL(a[i], SPLAT(x));
+
+	fldv_carry(res);
+}
+
+
+/*
+ * fldv_cswap - swaps a and b in all lanes where mask is all ones.
+ */
+static INLINE void
+fldv_cswap(fldv_t a, fldv_t b, vec_t mask)
+{
+	vec_t t;
+	int i;
+
+	for (i = 0; i < LIMBS; i++) {
+		t = (a[i] ^ b[i]) & mask;
+		a[i] ^= t;
+		b[i] ^= t;
+	}
+}
+
+
+/*
+ * mg_scale_lanes - runs LANES independent montgomery ladders, one in
+ * each lane, and returns s[i] * (u[i] : 1) in projective form
+ * (x[i] : z[i]).
+ *
+ * the scalars must be clamped, like for mg_scale in x25519.c the ladder
+ * starts at bit 253 with ((u : 1), 2*(u : 1)) and finishes with three
+ * doublings.
+ */
+static void
+mg_scale_lanes(fld_t x[LANES], fld_t z[LANES], fld_t u[LANES],
+	       uint8_t s[LANES][32])
+{
+	fldv_t x1, x2, z2, x3, z3, A, B, AA, BB;
+	fld_t one;
+	vec_t bit, swap;
+	int i, k;
+
+	/*
+	 * (xo : zo) <- 2 * (xi : zi) like mg_double in x25519.c, with the
+	 * temporaries of the ladder step and E = AA - BB in B.
+	 */
+#define DOUBLE(xo, zo, xi, zi)						\
+	fldv_add(A, xi, zi);						\
+	fldv_sq(AA, A);							\
+	fldv_sub(B, xi, zi);						\
+	fldv_sq(BB, B);							\
+	fldv_mul(xo, AA, BB);						\
+	fldv_sub(B, AA, BB);						\
+	fldv_scale(zo, B, 121665);					\
+	fldv_add(zo, zo, AA);						\
+	fldv_mul(zo, zo, B)
+
+	fld_set0(one, 1);
+
+	/* bit 254 is set */
+	for (k = 0; k < LANES; k++) {
+		fldv_set(x1, k, u[k]);
+		fldv_set(x2, k, u[k]);
+		fldv_set(z2, k, one);
+	}
+	DOUBLE(x3, z3, x2, z2);
+
+	/* one swap per bit, see mg_scale in x25519.c */
+	swap = SPLAT(0);
+	for (i = 253; i >= 3; i--) {
+		for (k = 0; k < LANES; k++)
+			bit[k] = -(uint64_t)((s[k][i >> 3] >> (i & 7)) & 1);
+
+		swap ^= bit;
+		fldv_cswap(x2, x3, swap);
+		fldv_cswap(z2, z3, swap);
+		swap = bit;
+
+		/*
+		 * every temporary costs 10 vectors on the stack, so C, D
+		 * and then CB, DA go to x2, z2 and E to B, which are free
+		 * by then.
+		 */
+		fldv_add(A, x2, z2);
+		fldv_sub(B, x2, z2);
+		fldv_add(x2, x3, z3);
+		fldv_sub(z2, x3, z3);
+
+		fldv_sq(AA, A);
+		fldv_sq(BB, B);
+		fldv_mul(z2, z2, A);
+		fldv_mul(x2, x2, B);
+
+		/* (x3 : z3) <- ((DA + CB)^2 : x1 * (DA - CB)^2) */
+		fldv_add(x3, z2, x2);
+		fldv_sq(x3, x3);
+		fldv_sub(z3, z2, x2);
+		fldv_sq(z3, z3);
+		fldv_mul(z3, z3, x1);
+
+		/* (x2 : z2) <- (AA * BB : E * (AA + 121665 * E)) */
+		fldv_mul(x2, AA, BB);
+		fldv_sub(B, AA, BB);
+		fldv_scale(z2, B, 121665);
+		fldv_add(z2, z2, AA);
+		fldv_mul(z2, z2, B);
+	}
+
+	fldv_cswap(x2, x3, swap);
+	fldv_cswap(z2, z3, swap);
+
+	/* the lowest three bits are cleared */
+	for (i = 0; i < 3; i++) {
+		DOUBLE(x2, z2, x2, z2);
+	}
+
+#undef DOUBLE
+
+	for (k = 0; k < LANES; k++) {
+		fldv_get(x[k], x2, k);
+		fldv_get(z[k], z2, k);
+	}
+
+	burnlocal(x2);
+	burnlocal(z2);
+	burnlocal(x3);
+	burnlocal(z3);
+	burnlocal(A);
+	burnlocal(B);
+	burnlocal(AA);
+	burnlocal(BB);
+	burnlocal(bit);
+	burnlocal(swap);
+}
+
+#endif
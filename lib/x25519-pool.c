@@ -0,0 +1,369 @@
+/*
+ * pool of pre-generated ephemeral x25519 keypairs.
+ *
+ * This code is public domain.
+ *
+ * Philipp Lay <philipp.lay@illunis.net>
+ *
+ *
+ * The keypairs are kept in a bounded lock-free ring, where every slot
+ * carries a sequence number telling whether it is ready to be filled
+ * or to be taken (see Vyukov's bounded mpmc queue). Background threads
+ * keep the ring filled, using x25519_base_batch so that a whole chunk
+ * of public keys shares one inversion.
+ *
+ * Taking a keypair is a single successful compare-and-swap unless
+ * other threads take keypairs at the very same moment. If the ring runs
+ * empty the keypair is generated on the fly.
+ *
+ * The pool lives in memory of the caller, followed by its ring and the
+ * ids of the threads.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "eddsa.h"
+
+#include "burn.h"
+#include "random.h"
+#include "scratch.h"
+
+
+/* keypairs generated in one go by the refill threads */
+#define POOL_CHUNK		32
+
+/* time a sleeping refill thread waits before looking at the ring again */
+#define POOL_IDLE_NS		10000000
+
+
+#define LOAD(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define CAS(p, old, new)						\
+	__atomic_compare_exchange_n((p), (old), (new), 0,		\
+				    __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+
+
+struct slot {
+	size_t		seq;
+	uint8_t		sec[X25519_KEY_LEN];
+	uint8_t		pub[X25519_KEY_LEN];
+};
+
+struct x25519_pool {
+	struct slot	*ring;
+	size_t		mask;		/* number of slots - 1 */
+
+	size_t		head;		/* next slot to fill */
+	size_t		tail;		/* next slot to take */
+
+	int		fd;		/* random source */
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	wakeup;
+	int		idle;		/* number of sleeping refill threads */
+	int		stop;
+
+	int		nthreads;
+	pthread_t	*threads;
+};
+
+
+/*
+ * pool_push - put a keypair into the ring, returns 0 if the ring is full.
+ */
+static int
+pool_push(struct x25519_pool *pool, const uint8_t sec[X25519_KEY_LEN],
+	  const uint8_t pub[X25519_KEY_LEN])
+{
+	struct slot *slot;
+	size_t pos, seq;
+
+	pos = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &pool->ring[pos & pool->mask];
+		seq = LOAD(&slot->seq);
+
+		if (seq == pos) {
+			if (CAS(&pool->head, &pos, pos + 1))
+				break;
+		} else if ((ptrdiff_t)(seq - pos) < 0)
+			return 0;
+		else
+			pos = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	}
+
+	memcpy(slot->sec, sec, X25519_KEY_LEN);
+	memcpy(slot->pub, pub, X25519_KEY_LEN);
+	STORE(&slot->seq, pos + 1);
+
+	return 1;
+}
+
+
+/*
+ * pool_pop - take a keypair from the ring and wipe its slot, returns 0
+ * if the ring is empty.
+ */
+static int
+pool_pop(struct x25519_pool *pool, uint8_t sec[X25519_KEY_LEN],
+	 uint8_t pub[X25519_KEY_LEN])
+{
+	struct slot *slot;
+	size_t pos, seq;
+
+	pos = __atomic_load_n(&pool->tail, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &pool->ring[pos & pool->mask];
+		seq = LOAD(&slot->seq);
+
+		if (seq == pos + 1) {
+			if (CAS(&pool->tail, &pos, pos + 1))
+				break;
+		} else if ((ptrdiff_t)(seq - (pos + 1)) < 0)
+			return 0;
+		else
+			pos = __atomic_load_n(&pool->tail, __ATOMIC_RELAXED);
+	}
+
+	memcpy(sec, slot->sec, X25519_KEY_LEN);
+	memcpy(pub, slot->pub, X25519_KEY_LEN);
+	burn(slot->sec, X25519_KEY_LEN);
+	STORE(&slot->seq, pos + pool->mask + 1);
+
+	return 1;
+}
+
+
+/*
+ * pool_level - number of keypairs in the ring (approximately).
+ */
+static size_t
+pool_level(struct x25519_pool *pool)
+{
+	size_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	size_t tail = __atomic_load_n(&pool->tail, __ATOMIC_RELAXED);
+
+	return (head >= tail) ? head - tail : 0;
+}
+
+
+/*
+ * pool_sleep - let a refill thread wait until the ring drops below half
+ * or the pool is destroyed. returns 0 if the thread should exit.
+ */
+static int
+pool_sleep(struct x25519_pool *pool)
+{
+	struct timespec ts;
+	int run;
+
+	pthread_mutex_lock(&pool->lock);
+
+	/* idle is read without the lock in x25519_ephemeral_pool_take */
+	__atomic_fetch_add(&pool->idle, 1, __ATOMIC_RELEASE);
+	while (!pool->stop && pool_level(pool) > pool->mask / 2) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += POOL_IDLE_NS;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&pool->wakeup, &pool->lock, &ts);
+	}
+	__atomic_fetch_sub(&pool->idle, 1, __ATOMIC_RELEASE);
+
+	run = !pool->stop;
+	pthread_mutex_unlock(&pool->lock);
+
+	return run;
+}
+
+
+/*
+ * pool_refill - main loop of the refill threads
+ */
+static void *
+pool_refill(void *arg)
+{
+	struct x25519_pool *pool = (struct x25519_pool *)arg;
+	uint8_t sec[POOL_CHUNK][X25519_KEY_LEN];
+	uint8_t pub[POOL_CHUNK][X25519_KEY_LEN];
+	int i, full;
+
+	while (!LOAD(&pool->stop)) {
+		full = 0;
+
+		if (random_read(pool->fd, &sec[0][0], sizeof(sec)) == 0) {
+			x25519_base_batch(POOL_CHUNK, &pub[0][0], &sec[0][0]);
+
+			for (i = 0; i < POOL_CHUNK && !full; i++)
+				full = !pool_push(pool, sec[i], pub[i]);
+		} else
+			full = 1;
+
+		burn(sec, sizeof(sec));
+
+		if (full && !pool_sleep(pool))
+			break;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * pool_slots - number of slots of a pool holding size keypairs, a power
+ * of two.
+ */
+static size_t
+pool_slots(size_t size)
+{
+	size_t n;
+
+	for (n = 2; n < size; n <<= 1)
+		;
+
+	return n;
+}
+
+
+/*
+ * x25519_ephemeral_pool_size - bytes of memory for a pool holding up to
+ * size keypairs, which is filled by the given number of threads.
+ */
+size_t
+x25519_ephemeral_pool_size(size_t size, int threads)
+{
+	if (threads < 1)
+		threads = 1;
+
+	return SCRATCH_LEN(sizeof(struct x25519_pool)) +
+		SCRATCH_LEN(pool_slots(size) * sizeof(struct slot)) +
+		threads * sizeof(pthread_t);
+}
+
+
+/*
+ * x25519_ephemeral_pool_init - set up a pool in the memsize bytes at
+ * mem, which holds up to size keypairs and is kept filled by the given
+ * number of threads.
+ *
+ * returns NULL on failure, e.g. if memsize is less than
+ * x25519_ephemeral_pool_size.
+ */
+struct x25519_pool *
+x25519_ephemeral_pool_init(void *mem, size_t memsize, size_t size,
+			   int threads)
+{
+	struct x25519_pool *pool;
+	uint8_t *p = (uint8_t *)mem;
+	size_t n, i;
+
+	if (threads < 1)
+		threads = 1;
+
+	if (memsize < x25519_ephemeral_pool_size(size, threads))
+		return NULL;
+
+	n = pool_slots(size);
+
+	memset(mem, 0, x25519_ephemeral_pool_size(size, threads));
+
+	pool = scratch_take(&p, sizeof(struct x25519_pool));
+	pool->ring = scratch_take(&p, n * sizeof(struct slot));
+	pool->threads = scratch_take(&p, threads * sizeof(pthread_t));
+
+	pool->fd = open("/dev/urandom", O_RDONLY);
+	if (pool->fd < 0)
+		return NULL;
+
+	pool->mask = n - 1;
+	for (i = 0; i < n; i++)
+		pool->ring[i].seq = i;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wakeup, NULL);
+
+	for (pool->nthreads = 0; pool->nthreads < threads; pool->nthreads++) {
+		if (pthread_create(&pool->threads[pool->nthreads], NULL,
+				   pool_refill, pool) != 0)
+			break;
+	}
+
+	if (pool->nthreads == 0) {
+		x25519_ephemeral_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+
+/*
+ * x25519_ephemeral_pool_take - take a fresh keypair from the pool, if
+ * the pool is empty it is generated right away.
+ *
+ * returns false if no randomness was available.
+ */
+bool
+x25519_ephemeral_pool_take(struct x25519_pool *pool,
+			   uint8_t sec[X25519_KEY_LEN],
+			   uint8_t pub[X25519_KEY_LEN])
+{
+	int ok;
+
+	ok = pool_pop(pool, sec, pub);
+
+	/* wake up the refill threads, if the ring is half empty */
+	if (LOAD(&pool->idle) && pool_level(pool) <= pool->mask / 2) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_broadcast(&pool->wakeup);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	if (ok)
+		return true;
+
+	if (random_read(pool->fd, sec, X25519_KEY_LEN) != 0)
+		return false;
+
+	x25519_base(pub, sec);
+
+	return true;
+}
+
+
+/*
+ * x25519_ephemeral_pool_destroy - stop the refill threads and wipe all
+ * remaining keypairs. the memory of the pool may be reused afterwards.
+ */
+void
+x25519_ephemeral_pool_destroy(struct x25519_pool *pool)
+{
+	int i;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	STORE(&pool->stop, 1);
+	pthread_cond_broadcast(&pool->wakeup);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	burn(pool->ring, (pool->mask + 1) * sizeof(struct slot));
+
+	pthread_cond_destroy(&pool->wakeup);
+	pthread_mutex_destroy(&pool->lock);
+
+	close(pool->fd);
+}
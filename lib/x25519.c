@@ -15,111 +15,313 @@
 #include "eddsa.h"
 
 #include "fld.h"
+#include "burn.h"
 #include "burnstack.h"
+#include "scratch.h"
+#include "cpu.h"
 
 #include "ed.h"
 
+/* defines USE_MG_SCALE_AVX2 for 32bit */
+#ifdef USE_AVX2
+#include "x25519-avx2.h"
+#endif
+
+#ifdef USE_AVX512
+#include "x25519-avx512.h"
+#endif
+
+
+/*
+ * stack usage of do_x25519 to clean up, the avx2 ladder keeps its
+ * 256bit temporaries on the stack as well.
+ */
+#ifdef USE_MG_SCALE_AVX2
+#define X25519_STACK	4096
+#else
+#define X25519_STACK	2048
+#endif
+
+
+/*
+ * x25519_batch works on chunks of X25519_BATCH results, which share one
+ * field inversion. this must be a multiple of the number of simd lanes.
+ * the scratch variants take chunks of up to X25519_BATCH_MAX.
+ *
+ * the simd ladders keep all their lanes on the stack, which takes up to
+ * X25519_BATCH_STACK to clean up.
+ */
+#define X25519_BATCH		16
+#define X25519_BATCH_STACK	8192
+#define X25519_BATCH_MAX	1024
+
+/* temporaries of do_x25519_batch: s, u, x, z and zinv for n keys */
+#define MG_BATCH_LEN(n)						\
+	(SCRATCH_LEN((n) * X25519_KEY_LEN) + 4 * SCRATCH_LEN((n) * sizeof(fld_t)))
+
+/* temporaries of do_x25519_base_batch: R, t and tinv for n keys */
+#define BASE_BATCH_LEN(n)					\
+	(SCRATCH_LEN((n) * sizeof(struct ed)) + 2 * SCRATCH_LEN((n) * sizeof(fld_t)))
+
 
 /*
- * structure for a point of the elliptic curve in montgomery form
- * without it's y-coordinate.
+ * internal layout of struct x25519_peer_ctx
  */
-struct mg {
-	fld_t	x;
-	fld_t	z;
+struct peer {
+	struct ed_table	table;		/* lookup table for 8 * peer */
+	fld_t		u;		/* u-coordinate of the peer */
+	int		ladder;		/* no table, use the ladder */
 };
 
+/* make sure struct peer fits into struct x25519_peer_ctx */
+typedef char peer_size_check[
+	(sizeof(struct peer) <= sizeof(struct x25519_peer_ctx)) ? 1 : -1];
+
 
 /*
- * ctmemswap - helper function to conditionally swap a with b
+ * mg_double - calculates (x2 : z2) <- 2 * (x : z) on the montgomery curve.
  */
 static void
-ctmemswap(void *a, void *b, size_t len, uint8_t mask)
+mg_double(fld_t x2, fld_t z2, const fld_t x, const fld_t z)
 {
-	uint8_t *pa = (uint8_t*)a;
-	uint8_t *pb = (uint8_t*)b;
-	uint8_t *endp = pa + len;
-	uint8_t delta;
+	fld_t A, B, AA, BB, E;
 
-	while (pa < endp) {
-		delta = (*pa ^ *pb) & mask;
-		*pa++ ^= delta;
-		*pb++ ^= delta;
+	fld_add(A, x, z);
+	fld_sq(AA, A);
+	fld_sub(B, x, z);
+	fld_sq(BB, B);
+
+	fld_mul(x2, AA, BB);
+
+	fld_sub(E, AA, BB);
+	fld_scale(z2, E, 121665);
+	fld_add(z2, z2, AA);
+	fld_mul(z2, z2, E);
+
+	burnlocal(A);
+	burnlocal(B);
+	burnlocal(AA);
+	burnlocal(BB);
+	burnlocal(E);
+}
+
+
+/*
+ * mg_scale - calculates s * (u : 1) with the montgomery ladder and returns
+ * the result in projective form (x : z).
+ *
+ * s must be clamped: the known bits 255 and 254 as well as the three
+ * lowest bits are not processed by the ladder, instead we start with
+ * ((u : 1), 2*(u : 1)) and finish with three doublings.
+ *
+ * as in rfc 7748 we do only one conditional swap per bit, controlled by
+ * the xor of adjacent scalar bits.
+ */
+static void
+mg_scale(fld_t x, fld_t z, const fld_t u, const uint8_t s[X25519_KEY_LEN])
+{
+	fld_t x2, z2, x3, z3;
+	fld_t A, B, C, D, AA, BB, E, DA, CB;
+	limb_t bit, swap;
+	int i;
+
+	/* bit 254 is set */
+	memcpy(x2, u, sizeof(fld_t));
+	fld_set0(z2, 1);
+	mg_double(x3, z3, u, z2);
+
+	swap = 0;
+	for (i = 253; i >= 3; i--) {
+		bit = (s[i >> 3] >> (i & 7)) & 1;
+		swap ^= bit;
+		fld_cswap(x2, x3, -swap);
+		fld_cswap(z2, z3, -swap);
+		swap = bit;
+
+		fld_add(A, x2, z2);
+		fld_sq(AA, A);
+		fld_sub(B, x2, z2);
+		fld_sq(BB, B);
+
+		fld_add(C, x3, z3);
+		fld_sub(D, x3, z3);
+		fld_mul(DA, D, A);
+		fld_mul(CB, C, B);
+
+		/* (x3 : z3) <- ((DA + CB)^2 : u * (DA - CB)^2) */
+		fld_add(x3, DA, CB);
+		fld_sq(x3, x3);
+		fld_sub(z3, DA, CB);
+		fld_sq(z3, z3);
+		fld_mul(z3, z3, u);
+
+		/* (x2 : z2) <- (AA * BB : E * (AA + 121665 * E)) */
+		fld_mul(x2, AA, BB);
+		fld_sub(E, AA, BB);
+		fld_scale(z2, E, 121665);
+		fld_add(z2, z2, AA);
+		fld_mul(z2, z2, E);
 	}
+
+	fld_cswap(x2, x3, -swap);
+	fld_cswap(z2, z3, -swap);
+
+	/* the lowest three bits are cleared */
+	mg_double(x2, z2, x2, z2);
+	mg_double(x2, z2, x2, z2);
+	mg_double(x, z, x2, z2);
+
+	burnlocal(x2);
+	burnlocal(z2);
+	burnlocal(x3);
+	burnlocal(z3);
+	burnlocal(A);
+	burnlocal(B);
+	burnlocal(C);
+	burnlocal(D);
+	burnlocal(AA);
+	burnlocal(BB);
+	burnlocal(E);
+	burnlocal(DA);
+	burnlocal(CB);
+	burnlocal(bit);
+	burnlocal(swap);
 }
 
 
+/*
+ * clamp - copy scalar and clear/set the bits fixed by x25519
+ */
+static void
+clamp(uint8_t out[X25519_KEY_LEN], const uint8_t scalar[X25519_KEY_LEN])
+{
+	memcpy(out, scalar, X25519_KEY_LEN);
+	out[0] &= 0xf8;
+	out[31] &= 0x7f;
+	out[31] |= 0x40;
+}
+
 
 /*
- * montgomery - calculate montgomery's double-and-add formula
+ * mg_to_ed8 - maps the montgomery point with u-coordinate u to the
+ * edwards curve and multiplies it by 8, to get rid of the cofactor.
+ * (vartime)
  *
- * input: A, B, C := A-B with z=1
- * output: A <- 2*A, B <- A+B
+ * the sign of x is not determined by u, but this doesn't matter since
+ * -P has the same u-coordinate as P.
  *
+ * returns 0 if there is no such point, ie. u = -1 or u on the twist.
  */
-static void
-montgomery(struct mg *A, struct mg *B, const struct mg *C)
+static int
+mg_to_ed8(struct ed *P, const fld_t u)
 {
-	fld_t sumA, subA, sqsumA, sqsubA;
-	fld_t sumB, subB;
-	fld_t T1, T2, T3;
-	
-	/* calculate 2*A */
-	fld_add(sumA, A->x, A->z);
-	fld_sq(sqsumA, sumA);
-	
-	fld_sub(subA, A->x, A->z);
-	fld_sq(sqsubA, subA);
-	
-	fld_mul(A->x, sqsubA, sqsumA);
-	
-	fld_sub(T1, sqsumA, sqsubA);
-	fld_scale(T2, T1, 121665);
-	fld_add(T2, T2, sqsumA);
-	fld_mul(A->z, T1, T2);
+	uint8_t tmp[32];
+	fld_t zero, y, t;
+
+	fld_set0(zero, 0);
+
+	/* t <- u + 1, which must not be zero */
+	memcpy(t, u, sizeof(fld_t));
+	t[0]++;
+	if (fld_eq(t, zero))
+		return 0;
+
+	/* y <- (u - 1) / (u + 1) */
+	fld_inv_vartime(t, t);
+	memcpy(y, u, sizeof(fld_t));
+	y[0]--;
+	fld_mul(y, y, t);
+
+	fld_export(tmp, y);
+	ed_import(P, tmp);
+	if (!ed_on_curve(P))
+		return 0;
+
+	ed_clear_cofactor(P, P);
+
+	return 1;
+}
+
 
-	/* calculate A + B */
-	fld_add(sumB, B->x, B->z);
-	fld_sub(subB, B->x, B->z);
+/*
+ * sc_import_div8 - imports the clamped scalar s divided by 8.
+ *
+ * not inlined, as the compiler would otherwise keep the shifted bytes in
+ * callee-saved registers of ed_scale_mg, which ed_scale spills to the
+ * stack.
+ */
+static NOINLINE void
+sc_import_div8(sc_t k, const uint8_t s[X25519_KEY_LEN])
+{
+	uint8_t tmp[X25519_KEY_LEN];
+	int i;
 
-	fld_mul(T1, subA, sumB);
-	fld_mul(T2, sumA, subB);
-	
-	fld_add(T3, T1, T2);
-	fld_sq(B->x, T3);
+	for (i = 0; i < X25519_KEY_LEN-1; i++)
+		tmp[i] = (s[i] >> 3) | (s[i+1] << 5);
+	tmp[i] = s[i] >> 3;
 
-	fld_sub(T3, T1, T2);
-	fld_sq(T3, T3);
-	fld_mul(B->z, T3, C->x);
+	sc_import(k, tmp, sizeof(tmp));
+	burnlocal(tmp);
 }
 
 
+#ifdef USE_ED_ENGINE
+
 /*
- * mg_scale - calculates x * P with montgomery formula.
+ * ed_scale_mg - calculates s * (u : 1) like mg_scale, but with ed_scale on
+ * the edwards curve, ie. s/8 * (8 * P).
+ *
+ * this is selected with the cmake option USE_ED_ENGINE. on the cpus we
+ * measured, the ladder was faster with both field implementations
+ * (about 120k vs 160k cycles with 64bit and 260k vs 400k with 32bit
+ * limbs), since the mapping to the edwards curve needs a square root and
+ * the table of multiples another inversion.
  *
- * assumes:
- *   out != P
- *   P->z must be 1
+ * returns 0 if u can't be mapped to the edwards curve.
+ */
+static int
+ed_scale_mg(fld_t x, fld_t z, const fld_t u, const uint8_t s[X25519_KEY_LEN])
+{
+	struct ed P;
+	sc_t k;
+
+	if (!mg_to_ed8(&P, u))
+		return 0;
+
+	sc_import_div8(k, s);
+	ed_scale(&P, &P, k);
+
+	/* (x : z) <- (z + y : z - y) */
+	fld_add(x, P.z, P.y);
+	fld_sub(z, P.z, P.y);
+
+	burnlocal(k);
+	burnlocal(P);
+
+	return 1;
+}
+
+#endif
+
+
+/*
+ * mg_scale_dispatch - calculates s * (u : 1) with the fastest available
+ * engine, see mg_scale.
  */
 static void
-mg_scale(struct mg *out, const struct mg *P, const uint8_t x[X25519_KEY_LEN])
-{
-	struct mg T;
-	int8_t foo;
-	int i, j;
-
-	fld_set0(out->x, 1);
-	fld_set0(out->z, 0);
-	memcpy(&T, P, sizeof(struct mg));
-	
-	for (i = X25519_KEY_LEN-1; i >= 0; i--) {
-		foo = x[i];
-		for (j = 8; j > 0; j--, foo <<= 1) {
-			ctmemswap(out, &T, sizeof(struct mg), foo >> 7);
-			montgomery(out, &T, P);
-			ctmemswap(out, &T, sizeof(struct mg), foo >> 7);
-		}
-	}
+mg_scale_dispatch(fld_t x, fld_t z, const fld_t u,
+		  const uint8_t s[X25519_KEY_LEN])
+{
+#ifdef USE_ED_ENGINE
+	if (ed_scale_mg(x, z, u, s))
+		return;
+#endif
+#ifdef USE_MG_SCALE_AVX2
+	if (cpu_has_avx2())
+		mg_scale_avx2(x, z, u, s);
+	else
+#endif
+		mg_scale(x, z, u, s);
 }
 
 
@@ -131,22 +333,98 @@ do_x25519(uint8_t out[X25519_KEY_LEN],
 	     const uint8_t scalar[X25519_KEY_LEN],
 	     const uint8_t point[X25519_KEY_LEN])
 {
-	struct mg res, P;
+	fld_t x, z, u;
 	uint8_t s[X25519_KEY_LEN];
 
-	memcpy(s, scalar, X25519_KEY_LEN);
-	s[0] &= 0xf8;
-	s[31] &= 0x7f;
-	s[31] |= 0x40;
- 	
-	fld_import(P.x, point);
-	fld_set0(P.z, 1);
-	
-	mg_scale(&res, &P, s);
+	clamp(s, scalar);
+	fld_import(u, point);
+
+	mg_scale_dispatch(x, z, u, s);
+
+	fld_inv(z, z);
+	fld_mul(x, x, z);
+	fld_export(out, x);
+
+	burnlocal(s);
+	burnlocal(x);
+	burnlocal(z);
+}
+
+
+/*
+ * do_x25519_batch - calculates n independent x25519 results, running
+ * one ladder per simd lane if possible and finishing with a single
+ * batched inversion. mem holds MG_BATCH_LEN(n) bytes for the
+ * temporaries.
+ */
+static void
+do_x25519_batch(int n, uint8_t *out, const uint8_t *scalar,
+		const uint8_t *point, void *mem)
+{
+	uint8_t *p = (uint8_t *)mem;
+	uint8_t (*s)[X25519_KEY_LEN];
+	fld_t *u, *x, *z, *zinv;
+	int i;
+
+	s = scratch_take(&p, n * X25519_KEY_LEN);
+	u = scratch_take(&p, n * sizeof(fld_t));
+	x = scratch_take(&p, n * sizeof(fld_t));
+	z = scratch_take(&p, n * sizeof(fld_t));
+	zinv = scratch_take(&p, n * sizeof(fld_t));
+
+	for (i = 0; i < n; i++) {
+		clamp(s[i], scalar + i*X25519_KEY_LEN);
+		fld_import(u[i], point + i*X25519_KEY_LEN);
+	}
+
+	i = 0;
+
+#ifdef USE_AVX512
+	if (cpu_has_avx512f()) {
+		for (; i + 8 <= n; i += 8)
+			mg_scale8_avx512(x + i, z + i, u + i, s + i);
+	}
+#endif
+#ifdef USE_AVX2
+	if (cpu_has_avx2()) {
+		for (; i + 4 <= n; i += 4)
+			mg_scale4_avx2(x + i, z + i, u + i, s + i);
+	}
+#endif
+
+	/* the remaining ones are done one by one */
+	for (; i < n; i++)
+		mg_scale_dispatch(x[i], z[i], u[i], s[i]);
+
+	fld_inv_batch(zinv, z, n);
+
+	for (i = 0; i < n; i++) {
+		fld_mul(x[i], x[i], zinv[i]);
+		fld_export(out + i*X25519_KEY_LEN, x[i]);
+	}
+
+	/* mem may belong to the caller, so it's not left to burnstack */
+	burn(mem, MG_BATCH_LEN(n));
+}
+
+
+/*
+ * ed_export_mg - export the montgomery u-coordinate of edwards point R
+ */
+static void
+ed_export_mg(uint8_t out[X25519_KEY_LEN], const struct ed *R)
+{
+	fld_t u, t;
+
+	/* u <- (z + y) / (z - y) */
+	fld_sub(t, R->z, R->y);
+	fld_inv(t, t);
+	fld_add(u, R->z, R->y);
+	fld_mul(u, u, t);
 
-	fld_inv(res.z, res.z);
-	fld_mul(res.x, res.x, res.z);
-	fld_export(out, res.x);
+	fld_export(out, u);
+	burnlocal(u);
+	burnlocal(t);
 }
 
 
@@ -163,15 +441,11 @@ do_x25519_base(uint8_t out[X25519_KEY_LEN],
 
 	sc_t x;
 	struct ed R;
-	fld_t u, t;
 
 	/*
 	 * clear bits on input and import it as x
 	 */
-	memcpy(tmp, scalar, X25519_KEY_LEN);
-	tmp[0] &= 0xf8;
-	tmp[31] &= 0x7f;
-	tmp[31] |= 0x40;
+	clamp(tmp, scalar);
 
 	sc_import(x, tmp, sizeof(tmp));
 
@@ -182,18 +456,54 @@ do_x25519_base(uint8_t out[X25519_KEY_LEN],
 	ed_scale_base(&R, x);
 
 
-	/*
-	 * extract montgomery coordinate u from edwards point R
-	 */
+	ed_export_mg(out, &R);
 
-	/* u <- (z + y) / (z - y) */
-	fld_sub(t, R.z, R.y);
-	fld_inv(t, t);
-	fld_add(u, R.z, R.y);
-	fld_mul(u, u, t);
+	burnlocal(tmp);
+	burnlocal(x);
+	burnlocal(R);
+}
 
 
-	fld_export(out, u);
+/*
+ * do_x25519_base_batch - calculates n public values like do_x25519_base,
+ * but with a single batched inversion. mem holds BASE_BATCH_LEN(n) bytes
+ * for the temporaries.
+ */
+static void
+do_x25519_base_batch(int n, uint8_t *out, const uint8_t *scalar, void *mem)
+{
+	uint8_t *p = (uint8_t *)mem;
+	uint8_t tmp[X25519_KEY_LEN];
+	struct ed *R;
+	fld_t *t, *tinv;
+	fld_t u;
+	sc_t x;
+	int i;
+
+	R = scratch_take(&p, n * sizeof(struct ed));
+	t = scratch_take(&p, n * sizeof(fld_t));
+	tinv = scratch_take(&p, n * sizeof(fld_t));
+
+	for (i = 0; i < n; i++) {
+		clamp(tmp, scalar + i*X25519_KEY_LEN);
+		sc_import(x, tmp, sizeof(tmp));
+
+		ed_scale_base(&R[i], x);
+		fld_sub(t[i], R[i].z, R[i].y);
+	}
+
+	fld_inv_batch(tinv, t, n);
+
+	/* u <- (z + y) / (z - y) */
+	for (i = 0; i < n; i++) {
+		fld_add(u, R[i].z, R[i].y);
+		fld_mul(u, u, tinv[i]);
+		fld_export(out + i*X25519_KEY_LEN, u);
+	}
+
+	burn(mem, BASE_BATCH_LEN(n));
+	burnlocal(tmp);
+	burnlocal(x);
 }
 
 
@@ -218,7 +528,233 @@ x25519(uint8_t out[X25519_KEY_LEN],
        const uint8_t point[X25519_KEY_LEN])
 {
 	do_x25519(out, scalar, point);
+	burnstack(X25519_STACK);
+}
+
+
+/*
+ * base_chunks - calculates n public values in chunks of the given size,
+ * with the temporaries in mem.
+ */
+static void
+base_chunks(int chunk, size_t n, uint8_t *out, const uint8_t *scalar,
+	    void *mem)
+{
+	int m;
+
+	while (n > 0) {
+		m = (n < (size_t)chunk) ? (int)n : chunk;
+
+		do_x25519_base_batch(m, out, scalar, mem);
+
+		out += m * X25519_KEY_LEN;
+		scalar += m * X25519_KEY_LEN;
+		n -= m;
+	}
+}
+
+
+/*
+ * x25519_base_batch - calculates n public values, where out and scalar
+ * hold n keys of X25519_KEY_LEN bytes each.
+ */
+void
+x25519_base_batch(size_t n, uint8_t *out, const uint8_t *scalar)
+{
+	uint64_t mem[BASE_BATCH_LEN(X25519_BATCH) / 8];
+
+	base_chunks(X25519_BATCH, n, out, scalar, mem);
+	burnstack(2048);
+}
+
+
+/*
+ * x25519_base_batch_scratch_size - bytes of scratch memory
+ * x25519_base_batch_scratch needs for a batch of n keys.
+ */
+size_t
+x25519_base_batch_scratch_size(size_t n)
+{
+	if (n > X25519_BATCH_MAX)
+		n = X25519_BATCH_MAX;
+
+	return BASE_BATCH_LEN(n);
+}
+
+
+/*
+ * x25519_base_batch_scratch - like x25519_base_batch, but with the
+ * temporaries in the scratch memory s, in chunks as large as fit.
+ *
+ * returns false if s is too small for a single key.
+ */
+bool
+x25519_base_batch_scratch(const struct eddsa_scratch *s, size_t n,
+			  uint8_t *out, const uint8_t *scalar)
+{
+	size_t chunk;
+
+	chunk = s->size / BASE_BATCH_LEN(1);
+	if (chunk > X25519_BATCH_MAX)
+		chunk = X25519_BATCH_MAX;
+	if (chunk == 0)
+		return false;
+
+	base_chunks((int)chunk, n, out, scalar, s->mem);
 	burnstack(2048);
+
+	return true;
+}
+
+
+/*
+ * x25519_peer_init - prepare ctx for repeated x25519 with the public key
+ * point of a fixed peer. (vartime)
+ *
+ * we map point to the edwards curve and build a lookup table like the
+ * one of x25519_base for 8 times the resulting point.
+ *
+ * if point is on the twist there is no edwards point to map to, in this
+ * case (and for u = -1) x25519_with_peer falls back to the ladder.
+ */
+void
+x25519_peer_init(struct x25519_peer_ctx *ctx,
+		 const uint8_t point[X25519_KEY_LEN])
+{
+	struct peer *peer = (struct peer *)ctx;
+	struct ed P;
+
+	fld_import(peer->u, point);
+
+	peer->ladder = !mg_to_ed8(&P, peer->u);
+	if (!peer->ladder)
+		ed_table_init(&peer->table, &P);
+}
+
+
+/*
+ * do_x25519_with_peer - calculates x25519 with the peer prepared in ctx
+ */
+static void
+do_x25519_with_peer(uint8_t out[X25519_KEY_LEN],
+		    const uint8_t scalar[X25519_KEY_LEN],
+		    const struct peer *peer)
+{
+	uint8_t s[X25519_KEY_LEN];
+	fld_t x, z;
+	sc_t k;
+	struct ed R;
+
+	clamp(s, scalar);
+
+	if (peer->ladder) {
+		mg_scale_dispatch(x, z, peer->u, s);
+		fld_inv(z, z);
+		fld_mul(x, x, z);
+		fld_export(out, x);
+		burnlocal(x);
+	} else {
+		/* the table is for 8 * peer, so we use the scalar divided by 8 */
+		sc_import_div8(k, s);
+		ed_scale_table(&R, &peer->table, k);
+
+		ed_export_mg(out, &R);
+		burnlocal(k);
+	}
+
+	burnlocal(s);
+}
+
+
+/*
+ * x25519_with_peer - calculates x25519 of scalar with the peer prepared
+ * by x25519_peer_init, the result is the same as with x25519().
+ */
+void
+x25519_with_peer(uint8_t out[X25519_KEY_LEN],
+		 const uint8_t scalar[X25519_KEY_LEN],
+		 const struct x25519_peer_ctx *ctx)
+{
+	do_x25519_with_peer(out, scalar, (const struct peer *)ctx);
+	burnstack(X25519_STACK);
+}
+
+
+/*
+ * mg_chunks - calculates n x25519 results in chunks of the given size,
+ * with the temporaries in mem.
+ */
+static void
+mg_chunks(int chunk, size_t n, uint8_t *out, const uint8_t *scalar,
+	  const uint8_t *point, void *mem)
+{
+	int m;
+
+	while (n > 0) {
+		m = (n < (size_t)chunk) ? (int)n : chunk;
+
+		do_x25519_batch(m, out, scalar, point, mem);
+
+		out += m * X25519_KEY_LEN;
+		scalar += m * X25519_KEY_LEN;
+		point += m * X25519_KEY_LEN;
+		n -= m;
+	}
+}
+
+
+/*
+ * x25519_batch - calculates n independent x25519 results, where out,
+ * scalar and point hold n keys of X25519_KEY_LEN bytes each.
+ */
+void
+x25519_batch(size_t n, uint8_t *out, const uint8_t *scalar,
+	     const uint8_t *point)
+{
+	uint64_t mem[MG_BATCH_LEN(X25519_BATCH) / 8];
+
+	mg_chunks(X25519_BATCH, n, out, scalar, point, mem);
+	burnstack(X25519_BATCH_STACK);
+}
+
+
+/*
+ * x25519_batch_scratch_size - bytes of scratch memory x25519_batch_scratch
+ * needs for a batch of n keys.
+ */
+size_t
+x25519_batch_scratch_size(size_t n)
+{
+	if (n > X25519_BATCH_MAX)
+		n = X25519_BATCH_MAX;
+
+	return MG_BATCH_LEN(n);
+}
+
+
+/*
+ * x25519_batch_scratch - like x25519_batch, but with the temporaries in
+ * the scratch memory s, in chunks as large as fit. the secrets in s are
+ * wiped before it returns.
+ *
+ * returns false if s is too small for a single key.
+ */
+bool
+x25519_batch_scratch(const struct eddsa_scratch *s, size_t n, uint8_t *out,
+		     const uint8_t *scalar, const uint8_t *point)
+{
+	size_t chunk;
+
+	chunk = s->size / MG_BATCH_LEN(1);
+	if (chunk > X25519_BATCH_MAX)
+		chunk = X25519_BATCH_MAX;
+	if (chunk == 0)
+		return false;
+
+	mg_chunks((int)chunk, n, out, scalar, point, s->mem);
+	burnstack(X25519_BATCH_STACK);
+
+	return true;
 }
 
 
@@ -239,5 +775,5 @@ DH(uint8_t out[X25519_KEY_LEN],
    const uint8_t point[X25519_KEY_LEN])
 {
 	do_x25519(out, sec, point);
-	burnstack(2048);
+	burnstack(X25519_STACK);
 }
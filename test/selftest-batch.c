@@ -0,0 +1,324 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <eddsa.h>
+
+
+#define N	100
+#define KEYS	7
+
+
+static uint8_t	sec[KEYS][ED25519_KEY_LEN];
+static uint8_t	keys[KEYS][ED25519_KEY_LEN];
+
+static uint8_t	sigs[N][ED25519_SIG_LEN];
+static uint8_t	msgs[N][256];
+
+static const uint8_t *sig[N], *pub[N], *msg[N];
+static size_t len[N];
+static bool valid[N];
+
+static struct eddsa_scratch scratch;
+
+
+/*
+ * crafted signatures of the public key of the secret 0, 1, ..., 31 with
+ * the verdicts of ed25519_verify (and ed25519_verify2) and of the batch,
+ * which must be the same at every place of a batch.
+ */
+static const uint8_t crafted_pub[ED25519_KEY_LEN] = {
+	0x03, 0xa1, 0x07, 0xbf, 0xf3, 0xce, 0x10, 0xbe,
+	0x1d, 0x70, 0xdd, 0x18, 0xe7, 0x4b, 0xc0, 0x99,
+	0x67, 0xe4, 0xd6, 0x30, 0x9b, 0xa5, 0x0d, 0x5f,
+	0x1d, 0xdc, 0x86, 0x64, 0x12, 0x55, 0x31, 0xb8 };
+
+static const struct {
+	const char	*msg;
+	bool		single;
+	bool		batch;
+	uint8_t		sig[ED25519_SIG_LEN];
+} crafted[] = {
+	/* R with an added point of order 8, valid with the cofactor */
+	{ "torsion", false, true, {
+	  0xa1, 0xda, 0xfe, 0x12, 0xde, 0xee, 0x5b, 0x43,
+	  0xd3, 0x34, 0x66, 0x8a, 0x81, 0x6f, 0x34, 0xbd,
+	  0xc7, 0x7d, 0x5e, 0x16, 0x5a, 0x81, 0x9e, 0x45,
+	  0x87, 0xdb, 0x33, 0x61, 0x2c, 0x22, 0x6a, 0x53,
+	  0xcb, 0x49, 0xe0, 0xd2, 0xac, 0xa8, 0xc4, 0xed,
+	  0x78, 0x1e, 0xac, 0xbb, 0xeb, 0xa8, 0x3e, 0x2f,
+	  0x1e, 0x68, 0xd6, 0xc4, 0xde, 0x01, 0x1d, 0xa0,
+	  0xd4, 0x9f, 0xdd, 0xf1, 0x30, 0x2f, 0x10, 0x0a } },
+	/* R is the neutral element encoded with y = p + 1, S = t*a */
+	{ "noncanonical", false, false, {
+	  0xee, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f,
+	  0x50, 0x9c, 0x2f, 0xd7, 0xef, 0x81, 0xab, 0xbc,
+	  0xbb, 0x2a, 0xe1, 0xce, 0x88, 0x73, 0x6b, 0x13,
+	  0xba, 0x36, 0xbd, 0xc8, 0x4e, 0x9f, 0xca, 0xbe,
+	  0xf1, 0xe7, 0xa0, 0x97, 0x3a, 0xc3, 0xd2, 0x05 } },
+	/* a valid signature with m added to S, reduced by ed25519_verify */
+	{ "malleable", true, false, {
+	  0x3e, 0x8d, 0xc4, 0x28, 0xc5, 0x60, 0xfd, 0xb6,
+	  0x52, 0x17, 0x47, 0x50, 0x5f, 0x5f, 0xd6, 0x12,
+	  0xca, 0x6f, 0xe4, 0xdf, 0xa6, 0x02, 0x8c, 0x3b,
+	  0xe2, 0xa9, 0x25, 0x2b, 0xa3, 0x33, 0x38, 0x19,
+	  0x1d, 0x0a, 0x65, 0x09, 0xcd, 0x35, 0xb7, 0x13,
+	  0xd2, 0xa6, 0x44, 0x12, 0x52, 0xa7, 0x32, 0x4b,
+	  0x5d, 0x34, 0x98, 0xcc, 0x20, 0x72, 0x0a, 0xf7,
+	  0x2a, 0x54, 0xd7, 0x31, 0xf0, 0x18, 0xc5, 0x10 } },
+};
+
+
+/* the group order m, little endian */
+static const uint8_t con_m[32] = {
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+	0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 };
+
+
+/*
+ * add_m - adds the group order m to S of sig, which stays < 2^256.
+ */
+static void
+add_m(uint8_t sig[ED25519_SIG_LEN])
+{
+	unsigned int c = 0;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		c += sig[32+i] + con_m[i];
+		sig[32+i] = (uint8_t)c;
+		c >>= 8;
+	}
+}
+
+
+/*
+ * check - runs the batch verification of the first n signatures and
+ * compares with the expected result, where bad is the index of the only
+ * invalid signature or -1.
+ */
+static int
+check(int n, int bad)
+{
+	bool ok;
+	int i;
+
+	ok = ed25519_verify_batch(n, valid, sig, pub, msg, len);
+	if (ok != (bad < 0))
+		return 1;
+
+	for (i = 0; i < n; i++) {
+		if (valid[i] != (i != bad))
+			return 1;
+	}
+
+	/* the same without valid */
+	if (ed25519_verify_batch(n, NULL, sig, pub, msg, len) != ok)
+		return 1;
+
+	/* and in scratch memory for chunks of 1 + n % 23 signatures */
+	scratch.size = ed25519_verify_batch_scratch_size(1 + n % 23);
+	if (ed25519_verify_batch_scratch(&scratch, n, valid, sig, pub, msg,
+					 len) != ok)
+		return 1;
+
+	for (i = 0; i < n; i++) {
+		if (valid[i] != (i != bad))
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * check2 - like check, but verifies the pair i, i+1 with ed25519_verify2.
+ */
+static int
+check2(int i, int bad)
+{
+	bool ok, v[2];
+
+	ok = ed25519_verify2(v, sig + i, pub + i, msg + i, len + i);
+	if (ok != (bad < 0) || v[0] != (i != bad) || v[1] != (i + 1 != bad))
+		return 1;
+
+	if (ed25519_verify2(NULL, sig + i, pub + i, msg + i, len + i) != ok)
+		return 1;
+
+	return 0;
+}
+
+
+/*
+ * check_crafted - puts crafted signature k alone, into pairs and at the
+ * start and into the tail chunk of batches.
+ */
+static int
+check_crafted(unsigned int k)
+{
+	static const int place[][2] = {
+		{ 1, 0 }, { 2, 0 }, { 2, 1 }, { 17, 0 }, { 17, 16 }, { N, N-1 }
+	};
+	const uint8_t *savesig, *savepub, *savemsg;
+	size_t savelen;
+	int i, n, bad;
+
+	if (ed25519_verify(crafted[k].sig, crafted_pub,
+			   (const uint8_t *)crafted[k].msg,
+			   strlen(crafted[k].msg)) != crafted[k].single)
+		return 1;
+
+	for (i = 0; i < (int)(sizeof(place) / sizeof(place[0])); i++) {
+		n = place[i][0];
+		bad = crafted[k].batch ? -1 : place[i][1];
+
+		savesig = sig[place[i][1]];
+		savepub = pub[place[i][1]];
+		savemsg = msg[place[i][1]];
+		savelen = len[place[i][1]];
+
+		sig[place[i][1]] = crafted[k].sig;
+		pub[place[i][1]] = crafted_pub;
+		msg[place[i][1]] = (const uint8_t *)crafted[k].msg;
+		len[place[i][1]] = strlen(crafted[k].msg);
+
+		if (check(n, bad) != 0)
+			return 1;
+
+		bad = crafted[k].single ? -1 : place[i][1];
+		if (n == 2 && check2(0, bad) != 0)
+			return 1;
+
+		sig[place[i][1]] = savesig;
+		pub[place[i][1]] = savepub;
+		msg[place[i][1]] = savemsg;
+		len[place[i][1]] = savelen;
+	}
+
+	return 0;
+}
+
+
+int
+main()
+{
+	uint8_t savesig[ED25519_SIG_LEN], savemsg[sizeof(msgs[0])];
+	const uint8_t *savepub;
+	unsigned int k;
+	int i, j, n;
+
+	/* scratch memory for the largest chunks */
+	scratch.mem = malloc(ed25519_verify_batch_scratch_size(N));
+	if (scratch.mem == NULL)
+		return 1;
+
+	srand(0);
+
+	/* use pseudo-random for test keys (DO NOT DO THIS FOR REAL!) */
+	for (i = 0; i < KEYS; i++) {
+		for (j = 0; j < ED25519_KEY_LEN; j++)
+			sec[i][j] = (uint8_t)rand();
+		ed25519_genpub(keys[i], sec[i]);
+	}
+
+	/* most signatures are from key 0, the others are mixed */
+	for (i = 0; i < N; i++) {
+		j = (i % 3 == 0) ? rand() % KEYS : 0;
+
+		len[i] = rand() % sizeof(msgs[i]);
+		for (n = 0; n < (int)len[i]; n++)
+			msgs[i][n] = (uint8_t)rand();
+
+		ed25519_sign(sigs[i], sec[j], keys[j], msgs[i], len[i]);
+
+		sig[i] = sigs[i];
+		pub[i] = keys[j];
+		msg[i] = msgs[i];
+	}
+
+	for (n = 0; n <= N; n += 1 + n / 2) {
+		if (check(n, -1) != 0) {
+			fprintf(stderr, "batch-selftest: batch of %d signatures failed\n", n);
+			return 1;
+		}
+	}
+
+	for (i = 0; i + 1 < N; i += 2) {
+		if (check2(i, -1) != 0) {
+			fprintf(stderr, "batch-selftest: pair %d failed\n", i);
+			return 1;
+		}
+	}
+
+	/*
+	 * a modified S, R, public key or message must be found, as well as
+	 * S + m and R replaced by the neutral element encoded with y = p + 1.
+	 * ed25519_verify2 reduces S like ed25519_verify and accepts S + m.
+	 */
+	for (i = 0; i < N; i += 7) {
+		memcpy(savesig, sigs[i], ED25519_SIG_LEN);
+		memcpy(savemsg, msgs[i], sizeof(savemsg));
+		savepub = pub[i];
+
+		switch (i % 6) {
+		case 0:	sigs[i][40] ^= 1; break;
+		case 1:	sigs[i][3] ^= 1; break;
+		case 2:	pub[i] = keys[(pub[i] == keys[0]) ? 1 : 0]; break;
+		case 3:
+			/* an empty message can't be modified */
+			if (len[i] == 0)
+				continue;
+			msgs[i][len[i] / 2] ^= 1;
+			break;
+		case 4:	add_m(sigs[i]); break;
+		case 5:
+			memset(sigs[i], 0xff, 32);
+			sigs[i][0] = 0xee;
+			sigs[i][31] = 0x7f;
+			break;
+		}
+
+		if (check(N, i) != 0 ||
+		    check2(i & ~1, (i % 6 == 4) ? -1 : i) != 0) {
+			fprintf(stderr, "batch-selftest: bad signature %d not detected\n", i);
+			return 1;
+		}
+
+		memcpy(sigs[i], savesig, ED25519_SIG_LEN);
+		memcpy(msgs[i], savemsg, sizeof(savemsg));
+		pub[i] = savepub;
+	}
+
+	for (k = 0; k < sizeof(crafted) / sizeof(crafted[0]); k++) {
+		if (check_crafted(k) != 0) {
+			fprintf(stderr, "batch-selftest: crafted signature \"%s\" got different verdicts\n",
+				crafted[k].msg);
+			return 1;
+		}
+	}
+
+	/* too small scratch memory fails all signatures */
+	scratch.size = ed25519_verify_batch_scratch_size(1) - 1;
+	if (ed25519_verify_batch_scratch(&scratch, N, valid, sig, pub, msg, len) ||
+	    valid[0]) {
+		fprintf(stderr, "batch-selftest: too small scratch memory accepted\n");
+		return 1;
+	}
+
+	scratch.size = ed25519_verify_batch_scratch_size(N);
+	if (!ed25519_verify_batch_scratch(&scratch, N, NULL, sig, pub, msg, len)) {
+		fprintf(stderr, "batch-selftest: batch in scratch memory failed\n");
+		return 1;
+	}
+
+	free(scratch.mem);
+
+	return 0;
+}
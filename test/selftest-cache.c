@@ -0,0 +1,177 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <eddsa.h>
+
+
+#define N	32
+#define THREADS	4
+
+
+static uint8_t	sec[ED25519_KEY_LEN], pub[ED25519_KEY_LEN];
+static uint8_t	sigs[N][ED25519_SIG_LEN];
+static uint8_t	msgs[N][64];
+
+static struct ed25519_cache *cache;
+
+
+/*
+ * verify_all - verifies all signatures with the cache, signature i is
+ * expected to be valid for even i. returns the number of errors.
+ */
+static int
+verify_all(void)
+{
+	int i, err = 0;
+
+	for (i = 0; i < N; i++) {
+		if (ed25519_verify_cached(cache, sigs[i], pub, msgs[i],
+					  sizeof(msgs[i])) != (i % 2 == 0))
+			err++;
+	}
+
+	return err;
+}
+
+
+static void *
+thread(void *arg)
+{
+	int k;
+
+	for (k = 0; k < 100; k++) {
+		if (verify_all() != 0)
+			*(int *)arg = 1;
+	}
+
+	return NULL;
+}
+
+
+static int
+check_stats(const char *what, uint64_t hits, uint64_t misses,
+	    uint64_t inserts)
+{
+	struct ed25519_cache_stats stats;
+
+	ed25519_cache_stats(cache, &stats);
+	if (stats.hits != hits || stats.misses != misses ||
+	    stats.inserts != inserts) {
+		fprintf(stderr, "cache-selftest: %s: %lu hits, %lu misses, %lu inserts\n",
+			what, (unsigned long)stats.hits,
+			(unsigned long)stats.misses,
+			(unsigned long)stats.inserts);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int
+main()
+{
+	pthread_t tid[THREADS];
+	int err[THREADS];
+	void *mem;
+	int i, j;
+
+	/* memory for the largest cache */
+	mem = malloc(ed25519_cache_size(64*N));
+	if (mem == NULL)
+		return 1;
+
+	srand(0);
+
+	/* use pseudo-random for test keys (DO NOT DO THIS FOR REAL!) */
+	for (j = 0; j < ED25519_KEY_LEN; j++)
+		sec[j] = (uint8_t)rand();
+	ed25519_genpub(pub, sec);
+
+	/* every odd signature is broken */
+	for (i = 0; i < N; i++) {
+		for (j = 0; j < (int)sizeof(msgs[i]); j++)
+			msgs[i][j] = (uint8_t)rand();
+		ed25519_sign(sigs[i], sec, pub, msgs[i], sizeof(msgs[i]));
+		if (i % 2)
+			sigs[i][40] ^= 1;
+	}
+
+
+	/*
+	 * only valid signatures are cached. the cache is large enough, that
+	 * no set overflows (at least not with sane probability).
+	 */
+	cache = ed25519_cache_init(mem, ed25519_cache_size(64*N),
+				   ED25519_CACHE_VALID);
+	if (cache == NULL) {
+		fprintf(stderr, "cache-selftest: could not create cache\n");
+		return 1;
+	}
+
+	if (verify_all() != 0 || verify_all() != 0) {
+		fprintf(stderr, "cache-selftest: wrong result\n");
+		return 1;
+	}
+	if (check_stats("valid only", N/2, 3*N/2, N/2) != 0)
+		return 1;
+
+	/* a cached signature must not be valid for another message */
+	msgs[0][0] ^= 1;
+	if (ed25519_verify_cached(cache, sigs[0], pub, msgs[0],
+				  sizeof(msgs[0]))) {
+		fprintf(stderr, "cache-selftest: cached result for other message\n");
+		return 1;
+	}
+	msgs[0][0] ^= 1;
+
+	ed25519_cache_destroy(cache);
+
+
+	/* cache all results and share them between threads */
+	cache = ed25519_cache_init(mem, ed25519_cache_size(64*N),
+				   ED25519_CACHE_VALID | ED25519_CACHE_INVALID);
+	if (cache == NULL) {
+		fprintf(stderr, "cache-selftest: could not create cache\n");
+		return 1;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		err[i] = 0;
+		pthread_create(&tid[i], NULL, thread, &err[i]);
+	}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(tid[i], NULL);
+		if (err[i]) {
+			fprintf(stderr, "cache-selftest: wrong result in thread %d\n", i);
+			return 1;
+		}
+	}
+
+	ed25519_cache_destroy(cache);
+
+
+	/* a cache smaller than the working set has to evict */
+	cache = ed25519_cache_init(mem, ed25519_cache_size(4),
+				   ED25519_CACHE_VALID);
+	if (cache == NULL || verify_all() != 0 || verify_all() != 0 ||
+	    check_stats("small cache", 0, 2*N, N) != 0) {
+		fprintf(stderr, "cache-selftest: small cache failed\n");
+		return 1;
+	}
+
+	ed25519_cache_destroy(cache);
+
+	/* too small for the cache itself */
+	if (ed25519_cache_init(sigs, sizeof(sigs), ED25519_CACHE_VALID) != NULL) {
+		fprintf(stderr, "cache-selftest: too small memory accepted\n");
+		return 1;
+	}
+
+	free(mem);
+
+	return 0;
+}
@@ -12,6 +12,9 @@ int main()
 	uint8_t edsk[ED25519_KEY_LEN], edpk[ED25519_KEY_LEN];
 	uint8_t dhsk[X25519_KEY_LEN], dhpk[X25519_KEY_LEN];
 	uint8_t check[X25519_KEY_LEN];
+	uint8_t edpks[200][ED25519_KEY_LEN], dhpks[200][X25519_KEY_LEN];
+	uint64_t mem[256];
+	struct eddsa_scratch scratch = { mem, 0 };
 	unsigned int i, j;
 
 	/*
@@ -45,6 +48,49 @@ int main()
 	}
 
 
+	/*
+	 * test batch conversion against single conversion, including the
+	 * neutral element (y = 1) which has no u-coordinate.
+	 */
+
+	srand(0);
+
+	for (i = 0; i < 200; i++) {
+		for (j = 0; j < ED25519_KEY_LEN; j++)
+			edsk[j] = (uint8_t)rand();
+		ed25519_genpub(edpks[i], edsk);
+	}
+	memset(edpks[77], 0, ED25519_KEY_LEN);
+	edpks[77][0] = 1;
+
+	pk_ed25519_to_x25519_batch(200, &dhpks[0][0], &edpks[0][0]);
+
+	for (i = 0; i < 200; i++) {
+		pk_ed25519_to_x25519(check, edpks[i]);
+		if (memcmp(check, dhpks[i], X25519_KEY_LEN) != 0) {
+			fprintf(stderr, "convert-selftest: batch conversion failed for key %u!\n", i);
+			return 1;
+		}
+	}
+
+	/* the same in scratch memory, in chunks of 7 keys */
+	scratch.size = pk_ed25519_to_x25519_batch_scratch_size(7);
+	if (scratch.size > sizeof(mem) ||
+	    !pk_ed25519_to_x25519_batch_scratch(&scratch, 200, &dhpks[0][0],
+						&edpks[0][0])) {
+		fprintf(stderr, "convert-selftest: batch in scratch memory failed!\n");
+		return 1;
+	}
+
+	for (i = 0; i < 200; i++) {
+		pk_ed25519_to_x25519(check, edpks[i]);
+		if (memcmp(check, dhpks[i], X25519_KEY_LEN) != 0) {
+			fprintf(stderr, "convert-selftest: scratch batch conversion failed for key %u!\n", i);
+			return 1;
+		}
+	}
+
+
 	/*
 	 * test old API
 	 */
@@ -17,11 +17,37 @@ struct {
 const int table_num = sizeof(table) / sizeof(table[0]);
 
 
+/*
+ * verify_steps - runs the step-wise verification with the given ops per
+ * step, returns its result or -1 if it took a single step only.
+ */
+static int
+verify_steps(const uint8_t *sig, const uint8_t *pub, const uint8_t *msg,
+	     size_t len, unsigned int ops)
+{
+	struct ed25519_verify_ctx ctx;
+	int res, steps;
+
+	ed25519_verify_start(&ctx, sig, pub, msg, len);
+
+	steps = 0;
+	do {
+		res = ed25519_verify_step(&ctx, ops);
+		steps++;
+	} while (res < 0);
+
+	return (steps > 1) ? res : -1;
+}
+
+
 
 int main()
 {
 	uint8_t checkpub[ED25519_KEY_LEN];
 	uint8_t checksig[ED25519_SIG_LEN];
+	uint8_t t[ED25519_VERIFY_HASH_LEN];
+	uint8_t msg[1024];
+	struct iovec iov[3];
 
 	int i;
 
@@ -48,6 +74,56 @@ int main()
 			fprintf(stderr, "eddsa-selftest: verifying ed25519 signature number %d failed\n", i+1);
 			return 1;
 		}
+
+		/* check four: same with separate hash and curve step */
+		ed25519_verify_hash(t, table[i].sig, table[i].pub, table[i].msg, i);
+		if (!ed25519_verify_curve(table[i].sig, table[i].pub, t)) {
+			fprintf(stderr, "eddsa-selftest: two-phase verify of ed25519 signature number %d failed\n", i+1);
+			return 1;
+		}
+
+		/* check five: sign and verify the message in three pieces */
+		iov[0].iov_base = table[i].msg;
+		iov[0].iov_len = i / 3;
+		iov[1].iov_base = table[i].msg + i / 3;
+		iov[1].iov_len = 0;
+		iov[2].iov_base = table[i].msg + i / 3;
+		iov[2].iov_len = i - i / 3;
+
+		ed25519_signv(checksig, table[i].sec, table[i].pub, iov, 3);
+		if (memcmp(checksig, table[i].sig, ED25519_SIG_LEN) != 0) {
+			fprintf(stderr, "eddsa-selftest: generating ed25519 signature number %d from iovec failed\n", i+1);
+			return 1;
+		}
+
+		if (!ed25519_verifyv(table[i].sig, table[i].pub, iov, 3)) {
+			fprintf(stderr, "eddsa-selftest: verifying ed25519 signature number %d from iovec failed\n", i+1);
+			return 1;
+		}
+
+		/* check six: a modified message must not verify */
+		if (i > 0) {
+			memcpy(msg, table[i].msg, i);
+			msg[i / 2] ^= 1;
+			ed25519_verify_hash(t, table[i].sig, table[i].pub, msg, i);
+			if (ed25519_verify_curve(table[i].sig, table[i].pub, t)) {
+				fprintf(stderr, "eddsa-selftest: modified message number %d verified\n", i+1);
+				return 1;
+			}
+		}
+
+		/* check seven: step-wise verification with up to 50 ops */
+		if (verify_steps(table[i].sig, table[i].pub, table[i].msg, i,
+				 i % 51) != 1) {
+			fprintf(stderr, "eddsa-selftest: step-wise verify of ed25519 signature number %d failed\n", i+1);
+			return 1;
+		}
+
+		if (i > 0 && verify_steps(table[i].sig, table[i].pub, msg, i,
+					  i % 51) != 0) {
+			fprintf(stderr, "eddsa-selftest: modified message number %d verified step-wise\n", i+1);
+			return 1;
+		}
 	}
 
 
@@ -0,0 +1,262 @@
+/*
+ * checks the field inversions: fld_inv_vartime, fld_inv_batch and
+ * fld_inv_batch_vartime against fld_inv, and the squaring chain fld_sqn
+ * against repeated fld_sq, for the edge values of the field,
+ * non-canonical representations and pseudo-random elements.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fld.h"
+
+
+#define NVALS		24
+#define MAX_BATCH	40
+
+
+#ifdef USE_64BIT
+#define LIMB_MASK(i)	FLD_LIMB_MASK
+#else
+#define LIMB_MASK(i)	FLD_LIMB_MASK(1 - ((i) & 1))
+#endif
+
+
+/* the test values, see set_values */
+static fld_t vals[NVALS];
+
+
+/*
+ * set_bytes - imports the little-endian number with the given lowest
+ * and highest byte and all bytes in between set to mid.
+ */
+static void
+set_bytes(fld_t res, uint8_t lo, uint8_t mid, uint8_t hi)
+{
+	uint8_t buf[32];
+
+	memset(buf, mid, sizeof(buf));
+	buf[0] = lo;
+	buf[31] = hi;
+
+	fld_import(res, buf);
+}
+
+
+/*
+ * set_random - sets res to a pseudo-random element
+ */
+static void
+set_random(fld_t res)
+{
+	uint8_t buf[32];
+	int i;
+
+	for (i = 0; i < 32; i++)
+		buf[i] = (uint8_t)rand();
+
+	fld_import(res, buf);
+}
+
+
+/*
+ * set_q - sets res to q = 2^255 - 19 with every limb at its maximum,
+ * ie. a non-canonical form of zero.
+ */
+static void
+set_q(fld_t res)
+{
+	int i;
+
+	for (i = 0; i < FLD_LIMB_NUM; i++)
+		res[i] = LIMB_MASK(i);
+	res[0] -= 18;
+}
+
+
+/*
+ * set_values - the edge values 0, 1, q-1, q, q+1, 2^255-1 and 2^256-1,
+ * the limbs at their bounds, x + q and x - q and pseudo-random elements.
+ */
+static void
+set_values(void)
+{
+	fld_t q;
+	int i, k = 0;
+
+	set_bytes(vals[k++], 0x00, 0x00, 0x00);
+	set_bytes(vals[k++], 0x01, 0x00, 0x00);
+	set_bytes(vals[k++], 0xec, 0xff, 0x7f);
+	set_bytes(vals[k++], 0xed, 0xff, 0x7f);
+	set_bytes(vals[k++], 0xee, 0xff, 0x7f);
+	set_bytes(vals[k++], 0xff, 0xff, 0x7f);
+	set_bytes(vals[k++], 0xff, 0xff, 0xff);
+
+	/* q, -q and -1 in limbs */
+	set_q(q);
+	memcpy(vals[k++], q, sizeof(fld_t));
+	fld_neg(vals[k++], q);
+	fld_set0(vals[k], 0);
+	vals[k++][0] = -1;
+
+	/* all limbs at their maximum and minimum */
+	for (i = 0; i < FLD_LIMB_NUM; i++) {
+		vals[k][i] = LIMB_MASK(i);
+		vals[k+1][i] = -LIMB_MASK(i);
+	}
+	k += 2;
+
+	/* x + q and x - q */
+	for (i = 0; i < 3; i++) {
+		set_random(vals[k]);
+		fld_add(vals[k+1], vals[k], q);
+		fld_sub(vals[k+2], vals[k], q);
+		k += 3;
+	}
+
+	while (k < NVALS)
+		set_random(vals[k++]);
+}
+
+
+/*
+ * check_inv - compares fld_inv_vartime with fld_inv for z and checks
+ * that z times the inverse is one, or that it is zero for z = 0.
+ */
+static int
+check_inv(const fld_t z)
+{
+	fld_t ref, res, t, zero, one;
+
+	fld_set0(zero, 0);
+	fld_set0(one, 1);
+
+	fld_inv(ref, z);
+	fld_inv_vartime(res, z);
+
+	if (!fld_eq(res, ref))
+		return 1;
+
+	fld_mul(t, z, ref);
+	if (fld_eq(z, zero))
+		return !fld_eq(ref, zero);
+
+	return !fld_eq(t, one);
+}
+
+
+/*
+ * check_sqn - compares fld_sqn with n calls of fld_sq for x, and fld_sq
+ * with fld_mul.
+ */
+static int
+check_sqn(const fld_t x, int n)
+{
+	fld_t ref, res;
+	int i;
+
+	fld_sq(res, x);
+	fld_mul(ref, x, x);
+	if (!fld_eq(res, ref))
+		return 1;
+
+	memcpy(ref, x, sizeof(fld_t));
+	for (i = 0; i < n; i++)
+		fld_sq(ref, ref);
+
+	fld_sqn(res, x, n);
+
+	return !fld_eq(res, ref);
+}
+
+
+/*
+ * check_batch - compares the batched inversion of n elements, picked
+ * from the test values, against fld_inv. every zero-th element is set
+ * to zero, if zeroth is positive.
+ */
+static int
+check_batch(int n, int zeroth, int vartime)
+{
+	fld_t z[MAX_BATCH], copy[MAX_BATCH], res[MAX_BATCH], ref;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (zeroth > 0 && i % zeroth == zeroth-1)
+			fld_set0(z[i], 0);
+		else
+			memcpy(z[i], vals[rand() % NVALS], sizeof(fld_t));
+	}
+	memcpy(copy, z, n * sizeof(fld_t));
+
+	if (vartime)
+		fld_inv_batch_vartime(res, z, n);
+	else
+		fld_inv_batch(res, z, n);
+
+	/* z must not be modified */
+	if (memcmp(copy, z, n * sizeof(fld_t)) != 0)
+		return 1;
+
+	for (i = 0; i < n; i++) {
+		fld_inv(ref, z[i]);
+		if (!fld_eq(res[i], ref))
+			return 1;
+	}
+
+	return 0;
+}
+
+
+int
+main()
+{
+	static const int sqn[] = { 0, 1, 2, 3, 4, 5, 10, 20, 50, 100, 255 };
+	int i, k, n, zeroth, vartime;
+
+	srand(0);
+	set_values();
+
+	for (i = 0; i < NVALS; i++) {
+		if (check_inv(vals[i]) != 0) {
+			fprintf(stderr, "fld-selftest: fld_inv_vartime failed for value %d\n", i);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < 1000; i++) {
+		set_random(vals[NVALS-1]);
+		if (check_inv(vals[NVALS-1]) != 0) {
+			fprintf(stderr, "fld-selftest: fld_inv_vartime failed in run %d\n", i);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < NVALS; i++) {
+		for (k = 0; k < (int)(sizeof(sqn) / sizeof(sqn[0])); k++) {
+			if (check_sqn(vals[i], sqn[k]) == 0)
+				continue;
+
+			fprintf(stderr, "fld-selftest: fld_sqn failed for value %d and n = %d\n",
+				i, sqn[k]);
+			return 1;
+		}
+	}
+
+	for (vartime = 0; vartime < 2; vartime++) {
+		for (n = 1; n <= MAX_BATCH; n++) {
+			for (zeroth = 0; zeroth <= 3; zeroth++) {
+				if (check_batch(n, zeroth, vartime) == 0)
+					continue;
+
+				fprintf(stderr, "fld-selftest: %s failed for %d elements\n",
+					vartime ? "fld_inv_batch_vartime" : "fld_inv_batch", n);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
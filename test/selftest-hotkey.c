@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <eddsa.h>
+
+
+#define N	64
+
+
+/* budgets for the windows 4, 8 and 9 (see ed25519_hotkey_size) */
+static const size_t budgets[] = { 64 << 10, 512 << 10, 3 << 20 };
+
+
+int
+main()
+{
+	uint8_t sec[ED25519_KEY_LEN], pub[ED25519_KEY_LEN];
+	uint8_t sig[ED25519_SIG_LEN], msg[256];
+	struct ed25519_hotkey *key;
+	uint64_t *mem;
+	size_t size, len;
+	unsigned int b;
+	int i, j;
+	bool ok;
+
+	srand(0);
+
+	if (ed25519_hotkey_size(0) != 0 ||
+	    ed25519_hotkey_size(1 << 10) != 0 ||
+	    ed25519_hotkey_init(msg, sizeof(msg), pub) != NULL) {
+		fprintf(stderr, "hotkey-selftest: too small budget accepted\n");
+		return 1;
+	}
+
+	for (b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+		size = ed25519_hotkey_size(budgets[b]);
+		if (size == 0 || size > budgets[b] ||
+		    (b > 0 && size <= ed25519_hotkey_size(budgets[b-1]))) {
+			fprintf(stderr, "hotkey-selftest: bad size %lu for budget %lu\n",
+				(unsigned long)size, (unsigned long)budgets[b]);
+			return 1;
+		}
+
+		/* use pseudo-random for test keys (DO NOT DO THIS FOR REAL!) */
+		for (j = 0; j < ED25519_KEY_LEN; j++)
+			sec[j] = (uint8_t)rand();
+		ed25519_genpub(pub, sec);
+
+		mem = malloc(size);
+		key = ed25519_hotkey_init(mem, size, pub);
+		if (key == NULL) {
+			fprintf(stderr, "hotkey-selftest: init failed\n");
+			return 1;
+		}
+
+		for (i = 0; i < N; i++) {
+			len = rand() % sizeof(msg);
+			for (j = 0; j < (int)len; j++)
+				msg[j] = (uint8_t)rand();
+
+			ed25519_sign(sig, sec, pub, msg, len);
+
+			/* modify S, R or the message for some of them */
+			switch (i % 8) {
+			case 1:	sig[32 + rand() % 32] ^= 1 << (rand() % 8); break;
+			case 2:	sig[rand() % 32] ^= 1 << (rand() % 8); break;
+			case 3:	if (len > 0) msg[rand() % len] ^= 1; break;
+			}
+
+			ok = ed25519_verify_hotkey(sig, key, msg, len);
+			if (ok != ed25519_verify(sig, pub, msg, len) ||
+			    ok != (i % 8 == 0 || i % 8 > 3 ||
+				   (i % 8 == 3 && len == 0))) {
+				fprintf(stderr, "hotkey-selftest: signature %d of budget %lu failed\n",
+					i, (unsigned long)budgets[b]);
+				return 1;
+			}
+		}
+
+		free(mem);
+	}
+
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * checks the simd montgomery ladders mg_scale_avx2 (only built for
+ * 32bit), mg_scale4_avx2 and mg_scale8_avx512, which skip the known bits
+ * of clamped scalars, and x25519 against a plain ladder over all bits of
+ * the scalar (rfc 7748).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <eddsa.h>
+
+#include "fld.h"
+#include "cpu.h"
+
+#ifdef USE_AVX2
+#include "x25519-avx2.h"
+#endif
+#ifdef USE_AVX512
+#include "x25519-avx512.h"
+#endif
+
+
+#define NUM	64
+
+
+static uint8_t	scalars[NUM][X25519_KEY_LEN];
+static uint8_t	points[NUM][X25519_KEY_LEN];
+static uint8_t	results[NUM][X25519_KEY_LEN];
+
+static fld_t	u[NUM], x[NUM], z[NUM];
+
+
+/*
+ * clamp - clamps the scalar s like x25519 does.
+ */
+static void
+clamp(uint8_t s[X25519_KEY_LEN])
+{
+	s[0] &= 0xf8;
+	s[31] &= 0x7f;
+	s[31] |= 0x40;
+}
+
+
+/*
+ * ladder - calculates s * (u : 1) with the ladder of rfc 7748, which
+ * starts at (1 : 0) and processes all 255 bits of s.
+ */
+static void
+ladder(fld_t x2, fld_t z2, const fld_t u, const uint8_t s[X25519_KEY_LEN])
+{
+	fld_t x3, z3, A, B, C, D, AA, BB, E, DA, CB;
+	limb_t bit, swap = 0;
+	int i;
+
+	fld_set0(x2, 1);
+	fld_set0(z2, 0);
+	memcpy(x3, u, sizeof(fld_t));
+	fld_set0(z3, 1);
+
+	for (i = 254; i >= 0; i--) {
+		bit = (s[i >> 3] >> (i & 7)) & 1;
+		swap ^= bit;
+		fld_cswap(x2, x3, -swap);
+		fld_cswap(z2, z3, -swap);
+		swap = bit;
+
+		fld_add(A, x2, z2);
+		fld_sq(AA, A);
+		fld_sub(B, x2, z2);
+		fld_sq(BB, B);
+		fld_sub(E, AA, BB);
+		fld_add(C, x3, z3);
+		fld_sub(D, x3, z3);
+		fld_mul(DA, D, A);
+		fld_mul(CB, C, B);
+
+		fld_add(x3, DA, CB);
+		fld_sq(x3, x3);
+		fld_sub(z3, DA, CB);
+		fld_sq(z3, z3);
+		fld_mul(z3, z3, u);
+
+		fld_mul(x2, AA, BB);
+		fld_scale(z2, E, 121665);
+		fld_add(z2, z2, AA);
+		fld_mul(z2, z2, E);
+	}
+
+	fld_cswap(x2, x3, -swap);
+	fld_cswap(z2, z3, -swap);
+}
+
+
+/*
+ * compare - compares the affine u-coordinates of the projective results
+ * (x[i] : z[i]) with the ones of the plain ladder.
+ */
+static int
+compare(void)
+{
+	uint8_t out[X25519_KEY_LEN];
+	fld_t t;
+	int i;
+
+	for (i = 0; i < NUM; i++) {
+		fld_inv(t, z[i]);
+		fld_mul(t, x[i], t);
+		fld_export(out, t);
+
+		if (memcmp(out, results[i], X25519_KEY_LEN) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+int
+main()
+{
+	uint8_t out[X25519_KEY_LEN];
+	int i, j;
+
+	srand(0);
+
+	/*
+	 * the smallest and largest clamped scalars and bit patterns, the
+	 * others are pseudo-random. the points 0, 1 and 9 come first.
+	 */
+	for (i = 0; i < NUM; i++) {
+		for (j = 0; j < X25519_KEY_LEN; j++) {
+			switch (i) {
+			case 0:	scalars[i][j] = 0x00; break;
+			case 1:	scalars[i][j] = 0xff; break;
+			case 2:	scalars[i][j] = 0x55; break;
+			case 3:	scalars[i][j] = 0xaa; break;
+			default: scalars[i][j] = (uint8_t)rand(); break;
+			}
+			points[i][j] = (i < 3) ? 0 : (uint8_t)rand();
+		}
+		clamp(scalars[i]);
+
+		if (i < 3)
+			points[i][0] = (i == 2) ? 9 : i;
+		points[i][31] &= 0x7f;
+
+		fld_import(u[i], points[i]);
+		ladder(x[i], z[i], u[i], scalars[i]);
+
+		fld_inv(z[i], z[i]);
+		fld_mul(x[i], x[i], z[i]);
+		fld_export(results[i], x[i]);
+
+		x25519(out, scalars[i], points[i]);
+		if (memcmp(out, results[i], X25519_KEY_LEN) != 0) {
+			fprintf(stderr, "lanes-selftest: x25519 differs from the plain ladder for %d\n", i);
+			return 1;
+		}
+	}
+
+#ifdef USE_AVX2
+	if (cpu_has_avx2()) {
+#ifdef USE_MG_SCALE_AVX2
+		for (i = 0; i < NUM; i++)
+			mg_scale_avx2(x[i], z[i], u[i], scalars[i]);
+
+		if (compare() != 0) {
+			fprintf(stderr, "lanes-selftest: mg_scale_avx2 differs from the plain ladder\n");
+			return 1;
+		}
+#endif
+
+		memset(x, 0, sizeof(x));
+		memset(z, 0, sizeof(z));
+		for (i = 0; i + 4 <= NUM; i += 4)
+			mg_scale4_avx2(x + i, z + i, u + i, scalars + i);
+
+		if (compare() != 0) {
+			fprintf(stderr, "lanes-selftest: mg_scale4_avx2 differs from the plain ladder\n");
+			return 1;
+		}
+	}
+#endif
+
+#ifdef USE_AVX512
+	if (cpu_has_avx512f()) {
+		memset(x, 0, sizeof(x));
+		memset(z, 0, sizeof(z));
+		for (i = 0; i + 8 <= NUM; i += 8)
+			mg_scale8_avx512(x + i, z + i, u + i, scalars + i);
+
+		if (compare() != 0) {
+			fprintf(stderr, "lanes-selftest: mg_scale8_avx512 differs from the plain ladder\n");
+			return 1;
+		}
+	}
+#endif
+
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <eddsa.h>
+
+
+#define TAKES	500
+
+
+int
+main()
+{
+	static uint8_t sec[TAKES][X25519_KEY_LEN];
+	uint8_t pub[X25519_KEY_LEN], check[X25519_KEY_LEN];
+	struct x25519_pool *pool;
+	size_t len;
+	void *mem;
+	int i, j;
+
+	len = x25519_ephemeral_pool_size(64, 2);
+	mem = malloc(len);
+	if (mem == NULL)
+		return 1;
+
+	pool = x25519_ephemeral_pool_init(mem, len, 64, 2);
+	if (pool == NULL) {
+		fprintf(stderr, "pool-selftest: could not create pool\n");
+		return 1;
+	}
+
+	/*
+	 * take more keys than the pool holds, so we also run into an
+	 * empty pool and check them against x25519_base.
+	 */
+	for (i = 0; i < TAKES; i++) {
+		if (!x25519_ephemeral_pool_take(pool, sec[i], pub)) {
+			fprintf(stderr, "pool-selftest: take number %d failed\n", i+1);
+			return 1;
+		}
+
+		x25519_base(check, sec[i]);
+		if (memcmp(check, pub, X25519_KEY_LEN) != 0) {
+			fprintf(stderr, "pool-selftest: keypair number %d is wrong\n", i+1);
+			return 1;
+		}
+
+		for (j = 0; j < i; j++) {
+			if (memcmp(sec[i], sec[j], X25519_KEY_LEN) == 0) {
+				fprintf(stderr, "pool-selftest: keypair number %d repeated\n", i+1);
+				return 1;
+			}
+		}
+	}
+
+	x25519_ephemeral_pool_destroy(pool);
+	free(mem);
+
+	return 0;
+}
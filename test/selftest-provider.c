@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <eddsa.h>
+
+#include "sha512.h"
+
+
+#define RUNS	256
+
+
+/*
+ * external provider wrapping the builtin sha512, counting its calls
+ */
+static int calls;
+
+static void
+ext_init(void *ctx)
+{
+	calls++;
+	sha512_init((struct sha512 *)ctx);
+}
+
+static void
+ext_update(void *ctx, const uint8_t *data, size_t len)
+{
+	sha512_add((struct sha512 *)ctx, data, len);
+}
+
+static void
+ext_final(void *ctx, uint8_t out[64])
+{
+	sha512_final((struct sha512 *)ctx, out);
+}
+
+static const struct ed25519_sha512_provider provider = {
+	sizeof(struct sha512), ext_init, ext_update, ext_final
+};
+
+static const struct ed25519_sha512_provider too_large = {
+	ED25519_SHA512_CTX_MAX + 1, ext_init, ext_update, ext_final
+};
+
+
+/*
+ * run - creates a key and a signature for pseudo-random sec and msg and
+ * checks the signature.
+ */
+static int
+run(uint8_t pub[ED25519_KEY_LEN], uint8_t sig[ED25519_SIG_LEN],
+    const uint8_t sec[ED25519_KEY_LEN], const uint8_t *msg, size_t len)
+{
+	ed25519_genpub(pub, sec);
+	ed25519_sign(sig, sec, pub, msg, len);
+
+	return ed25519_verify(sig, pub, msg, len) ? 0 : 1;
+}
+
+
+int
+main()
+{
+	uint8_t sec[ED25519_KEY_LEN], msg[1024];
+	uint8_t pub[2][ED25519_KEY_LEN], sig[2][ED25519_SIG_LEN];
+	size_t len;
+	int i, j;
+
+	if (ed25519_set_sha512(&too_large)) {
+		fprintf(stderr, "provider-selftest: too large context accepted\n");
+		return 1;
+	}
+
+	srand(0);
+
+	for (i = 0; i < RUNS; i++) {
+		for (j = 0; j < ED25519_KEY_LEN; j++)
+			sec[j] = (uint8_t)rand();
+		len = rand() % sizeof(msg);
+		for (j = 0; j < (int)len; j++)
+			msg[j] = (uint8_t)rand();
+
+		/* builtin sha512 */
+		ed25519_set_sha512(NULL);
+		calls = 0;
+		if (run(pub[0], sig[0], sec, msg, len) != 0 || calls != 0) {
+			fprintf(stderr, "provider-selftest: builtin run %d failed\n", i+1);
+			return 1;
+		}
+
+		/* external provider */
+		if (!ed25519_set_sha512(&provider)) {
+			fprintf(stderr, "provider-selftest: provider rejected\n");
+			return 1;
+		}
+		if (run(pub[1], sig[1], sec, msg, len) != 0 || calls == 0) {
+			fprintf(stderr, "provider-selftest: provider run %d failed\n", i+1);
+			return 1;
+		}
+
+		if (memcmp(pub[0], pub[1], ED25519_KEY_LEN) != 0 ||
+		    memcmp(sig[0], sig[1], ED25519_SIG_LEN) != 0) {
+			fprintf(stderr, "provider-selftest: results differ in run %d\n", i+1);
+			return 1;
+		}
+	}
+
+	ed25519_set_sha512(NULL);
+
+	return 0;
+}
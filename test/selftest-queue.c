@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <eddsa.h>
+
+
+#define N	300
+#define KEYS	3
+
+
+static uint8_t	sec[KEYS][ED25519_KEY_LEN], pub[KEYS][ED25519_KEY_LEN];
+static uint8_t	sigs[N][ED25519_SIG_LEN];
+static uint8_t	msgs[N][100];
+
+/* result of signature i: 0 - not reported, 1 - bad, 2 - ok */
+static int	result[N];
+
+/*
+ * signature of "torsion" with a point of order 8 added to R, see
+ * selftest-batch. it passes the batch, but not ed25519_verify, and its
+ * verdict must not depend on the batch it ends up in.
+ */
+static const uint8_t torsion_pub[ED25519_KEY_LEN] = {
+	0x03, 0xa1, 0x07, 0xbf, 0xf3, 0xce, 0x10, 0xbe,
+	0x1d, 0x70, 0xdd, 0x18, 0xe7, 0x4b, 0xc0, 0x99,
+	0x67, 0xe4, 0xd6, 0x30, 0x9b, 0xa5, 0x0d, 0x5f,
+	0x1d, 0xdc, 0x86, 0x64, 0x12, 0x55, 0x31, 0xb8 };
+
+static const uint8_t torsion_sig[ED25519_SIG_LEN] = {
+	0xa1, 0xda, 0xfe, 0x12, 0xde, 0xee, 0x5b, 0x43,
+	0xd3, 0x34, 0x66, 0x8a, 0x81, 0x6f, 0x34, 0xbd,
+	0xc7, 0x7d, 0x5e, 0x16, 0x5a, 0x81, 0x9e, 0x45,
+	0x87, 0xdb, 0x33, 0x61, 0x2c, 0x22, 0x6a, 0x53,
+	0xcb, 0x49, 0xe0, 0xd2, 0xac, 0xa8, 0xc4, 0xed,
+	0x78, 0x1e, 0xac, 0xbb, 0xeb, 0xa8, 0x3e, 0x2f,
+	0x1e, 0x68, 0xd6, 0xc4, 0xde, 0x01, 0x1d, 0xa0,
+	0xd4, 0x9f, 0xdd, 0xf1, 0x30, 0x2f, 0x10, 0x0a };
+
+
+static void
+done(void *user, bool ok)
+{
+	int *res = (int *)user;
+
+	/* every signature is reported once */
+	__atomic_store_n(res, (*res != 0) ? -1 : ok ? 2 : 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * run_torsion - submits the torsion signature followed by max_batch - 1
+ * valid ones to a queue with batches of max_batch signatures.
+ *
+ * returns the result of the torsion signature, 0 if another one failed.
+ */
+static int
+run_torsion(void *mem, size_t max_batch)
+{
+	struct ed25519_queue *q;
+	size_t i;
+
+	q = ed25519_queue_init(mem, ed25519_queue_size(max_batch, 1, max_batch),
+			       max_batch, 1, max_batch, 1000000);
+	if (q == NULL)
+		return 0;
+
+	memset(result, 0, sizeof(result));
+
+	ed25519_queue_submit(q, torsion_sig, torsion_pub,
+			     (const uint8_t *)"torsion", 7, done, &result[0]);
+	for (i = 1; i < max_batch; i++)
+		ed25519_queue_submit(q, sigs[7*i], pub[7*i % KEYS], msgs[7*i],
+				     sizeof(msgs[7*i]), done, &result[i]);
+
+	ed25519_queue_destroy(q);
+
+	for (i = 1; i < max_batch; i++) {
+		if (result[i] != 2)
+			return 0;
+	}
+
+	return result[0];
+}
+
+
+/*
+ * run - submits all signatures, every 7th of them is broken.
+ */
+static int
+run(struct ed25519_queue *q)
+{
+	struct ed25519_queue_stats stats;
+	int i;
+
+	memset(result, 0, sizeof(result));
+
+	for (i = 0; i < N; i++) {
+		if (!ed25519_queue_submit(q, sigs[i], pub[i % KEYS], msgs[i],
+					  sizeof(msgs[i]), done, &result[i])) {
+			fprintf(stderr, "queue-selftest: submit %d failed\n", i);
+			return 1;
+		}
+	}
+
+	ed25519_queue_stats(q, &stats);
+	ed25519_queue_destroy(q);
+
+	for (i = 0; i < N; i++) {
+		if (result[i] != ((i % 7 == 3) ? 1 : 2)) {
+			fprintf(stderr, "queue-selftest: result %d of signature %d\n",
+				result[i], i);
+			return 1;
+		}
+	}
+
+	if (stats.submitted != N || stats.rejected != 0 ||
+	    stats.max_depth == 0 || stats.max_depth > N) {
+		fprintf(stderr, "queue-selftest: wrong stats\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int
+main()
+{
+	struct ed25519_queue_stats stats;
+	struct ed25519_queue *q;
+	struct timespec ts = { 0, 1000000 };
+	void *mem;
+	int i, j;
+
+	/* memory for the largest queue */
+	mem = malloc(ed25519_queue_size(N, 2, 100));
+	if (mem == NULL)
+		return 1;
+
+	srand(0);
+
+	/* use pseudo-random for test keys (DO NOT DO THIS FOR REAL!) */
+	for (i = 0; i < KEYS; i++) {
+		for (j = 0; j < ED25519_KEY_LEN; j++)
+			sec[i][j] = (uint8_t)rand();
+		ed25519_genpub(pub[i], sec[i]);
+	}
+
+	for (i = 0; i < N; i++) {
+		for (j = 0; j < (int)sizeof(msgs[i]); j++)
+			msgs[i][j] = (uint8_t)rand();
+		ed25519_sign(sigs[i], sec[i % KEYS], pub[i % KEYS], msgs[i],
+			     sizeof(msgs[i]));
+		if (i % 7 == 3)
+			sigs[i][i % ED25519_SIG_LEN] ^= 1;
+	}
+
+	/* one byte less than ed25519_queue_size is not enough */
+	if (ed25519_queue_init(mem, ed25519_queue_size(N, 2, 32) - 1, N, 2, 32,
+			       1000000) != NULL) {
+		fprintf(stderr, "queue-selftest: too small memory accepted\n");
+		return 1;
+	}
+
+	/* batches of 32, destroy has to finish the rest */
+	q = ed25519_queue_init(mem, ed25519_queue_size(N, 2, 32), N, 2, 32,
+			       1000000);
+	if (q == NULL || run(q) != 0)
+		return 1;
+
+	/* single worker, no waiting */
+	q = ed25519_queue_init(mem, ed25519_queue_size(N, 1, 16), N, 1, 16, 0);
+	if (q == NULL || run(q) != 0)
+		return 1;
+
+	/*
+	 * a single signature in a large batch must be verified after
+	 * max_wait, long before destroy.
+	 */
+	q = ed25519_queue_init(mem, ed25519_queue_size(4, 1, 100), 4, 1, 100,
+			       1000);
+	if (q == NULL)
+		return 1;
+
+	result[0] = 0;
+	ed25519_queue_submit(q, sigs[0], pub[0], msgs[0], sizeof(msgs[0]),
+			     done, &result[0]);
+	for (i = 0; i < 5000 && __atomic_load_n(&result[0], __ATOMIC_ACQUIRE) == 0; i++)
+		nanosleep(&ts, NULL);
+
+	ed25519_queue_stats(q, &stats);
+	if (result[0] != 2 || stats.completed != 1 || stats.depth != 0 ||
+	    stats.latency_max_us < 1000) {
+		fprintf(stderr, "queue-selftest: max_wait flush failed\n");
+		return 1;
+	}
+
+	ed25519_queue_destroy(q);
+
+	/*
+	 * a queue of 5 signatures, which aren't verified before destroy,
+	 * takes exactly 5 of them and rejects the next ones.
+	 */
+	q = ed25519_queue_init(mem, ed25519_queue_size(5, 1, 100), 5, 1, 100,
+			       100000000);
+	if (q == NULL)
+		return 1;
+
+	memset(result, 0, sizeof(result));
+	for (i = 0; i < 16; i++) {
+		if (!ed25519_queue_submit(q, sigs[i], pub[i % KEYS], msgs[i],
+					  sizeof(msgs[i]), done, &result[i]))
+			break;
+	}
+	j = ed25519_queue_submit(q, sigs[i], pub[i % KEYS], msgs[i],
+				 sizeof(msgs[i]), done, &result[i]);
+	ed25519_queue_stats(q, &stats);
+	ed25519_queue_destroy(q);
+
+	if (i != 5 || j || stats.rejected != 2 || stats.max_depth != 5) {
+		fprintf(stderr, "queue-selftest: queue of 5 took %d signatures\n", i);
+		return 1;
+	}
+
+	for (i = 0; i < 5; i++) {
+		if (result[i] != ((i % 7 == 3) ? 1 : 2)) {
+			fprintf(stderr, "queue-selftest: result %d of signature %d in the full queue\n",
+				result[i], i);
+			return 1;
+		}
+	}
+
+	/* the torsion signature gets the batch verdict alone and in a batch */
+	if (run_torsion(mem, 1) != 2 || run_torsion(mem, 16) != 2) {
+		fprintf(stderr, "queue-selftest: verdict depends on the batch\n");
+		return 1;
+	}
+
+	free(mem);
+
+	return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * checks that no secrets are left on the stack after the functions
+ * handling secret keys return.
+ *
+ * every function runs on a stack of its own (with makecontext), which is
+ * searched afterwards for pieces of the secret key, its expanded form,
+ * the nonce of the signature and the scalars reduced from them. a piece
+ * is any 8 consecutive bytes, also in reversed byte order as sha512 loads
+ * them into its words. the scalars are searched for in exported form and
+ * as limbs of sc_t.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include <eddsa.h>
+
+#include "sha512.h"
+#include "sc.h"
+
+
+#define STACK_SIZE	(64 << 10)
+#define PATTERN		0xa5
+#define PIECE		8
+
+
+static uint8_t sec[ED25519_KEY_LEN], pub[ED25519_KEY_LEN];
+static uint8_t sig[ED25519_SIG_LEN], msg[200];
+static uint8_t point[X25519_KEY_LEN], out[X25519_KEY_LEN];
+
+/*
+ * the secrets: sec, h = SHA512(sec), the nonce SHA512(h[32..63], msg) and
+ * the scalars used by the library, each exported and as limbs.
+ */
+enum { SEC, HASH, NONCE, A, A_LIMBS, R, R_LIMBS, X, X_LIMBS, K, K_LIMBS,
+       NSECRETS };
+
+static const char *secret_name[NSECRETS] = {
+	"sec", "SHA512(sec)", "nonce",
+	"a", "limbs of a",
+	"r", "limbs of r",
+	"clamp(sec)", "limbs of clamp(sec)",
+	"clamp(sec)/8", "limbs of clamp(sec)/8",
+};
+
+static uint8_t secrets[NSECRETS][SHA512_HASH_LENGTH];
+static size_t secret_len[NSECRETS];
+
+
+static void do_genpub(void) { ed25519_genpub(pub, sec); }
+static void do_sign(void) { ed25519_sign(sig, sec, pub, msg, sizeof(msg)); }
+static void do_x25519(void) { x25519(out, sec, point); }
+static void do_x25519_base(void) { x25519_base(out, sec); }
+static void do_sk_convert(void) { sk_ed25519_to_x25519(out, sec); }
+
+static const struct {
+	const char	*name;
+	void		(*fn)(void);
+} calls[] = {
+	{ "ed25519_genpub",		do_genpub },
+	{ "ed25519_sign",		do_sign },
+	{ "x25519",			do_x25519 },
+	{ "x25519_base",		do_x25519_base },
+	{ "sk_ed25519_to_x25519",	do_sk_convert },
+};
+
+
+#define NCALLS	(sizeof(calls) / sizeof(calls[0]))
+
+static uint8_t *stacks[NCALLS];
+static ucontext_t main_ctx, call_ctx;
+
+
+/*
+ * set_scalar - stores the scalar x exported and as limbs at secret i and
+ * i+1.
+ */
+static void
+set_scalar(int i, const sc_t x)
+{
+	sc_export(secrets[i], x);
+	secret_len[i] = 32;
+
+	memcpy(secrets[i+1], x, sizeof(sc_t));
+	secret_len[i+1] = sizeof(sc_t);
+}
+
+
+/*
+ * clamp - clears and sets the bits fixed by ed25519 and x25519
+ */
+static void
+clamp(uint8_t s[32])
+{
+	s[0] &= 0xf8;
+	s[31] &= 0x7f;
+	s[31] |= 0x40;
+}
+
+
+/*
+ * find - returns the offset of the first piece of s in stack or -1.
+ *
+ * pieces with more than three zero bytes are skipped, they come from
+ * the unused high bits of the limbs and would match by chance.
+ */
+static long
+find(const uint8_t *stack, const uint8_t *s, size_t len)
+{
+	uint8_t rev[PIECE];
+	size_t i, j, k, zeros;
+
+	for (i = 0; i + PIECE <= len; i++) {
+		for (k = 0, zeros = 0; k < PIECE; k++) {
+			rev[k] = s[i + PIECE-1 - k];
+			zeros += (rev[k] == 0);
+		}
+		if (zeros > 3)
+			continue;
+
+		for (j = 0; j + PIECE <= STACK_SIZE; j++) {
+			if (memcmp(stack + j, s + i, PIECE) == 0 ||
+			    memcmp(stack + j, rev, PIECE) == 0)
+				return j;
+		}
+	}
+
+	return -1;
+}
+
+
+/*
+ * run - runs fn on the fresh stack
+ */
+static int
+run(void (*fn)(void), uint8_t *stack)
+{
+	memset(stack, PATTERN, STACK_SIZE);
+
+	getcontext(&call_ctx);
+	call_ctx.uc_stack.ss_sp = stack;
+	call_ctx.uc_stack.ss_size = STACK_SIZE;
+	call_ctx.uc_link = &main_ctx;
+	makecontext(&call_ctx, fn, 0);
+
+	return swapcontext(&main_ctx, &call_ctx);
+}
+
+
+int
+main()
+{
+	struct sha512 hash;
+	uint8_t tmp[32];
+	sc_t x;
+	unsigned int i, k;
+	long pos;
+	int j, failed = 0;
+
+	srand(0);
+
+	/* use pseudo-random for test keys (DO NOT DO THIS FOR REAL!) */
+	for (j = 0; j < ED25519_KEY_LEN; j++)
+		sec[j] = (uint8_t)rand();
+	for (j = 0; j < (int)sizeof(msg); j++)
+		msg[j] = (uint8_t)rand();
+
+	ed25519_genpub(pub, sec);
+	pk_ed25519_to_x25519(point, pub);
+
+	/*
+	 * every call runs twice and only the second run counts: with lazy
+	 * binding the dynamic linker saves all registers on the stack of
+	 * the first call of a function, which may still hold the secrets of
+	 * ed25519_genpub above.
+	 */
+	for (i = 0; i < NCALLS; i++) {
+		stacks[i] = malloc(STACK_SIZE);
+		if (stacks[i] == NULL || run(calls[i].fn, stacks[i]) != 0 ||
+		    run(calls[i].fn, stacks[i]) != 0) {
+			fprintf(stderr, "scrub-selftest: can't run %s\n",
+				calls[i].name);
+			return 1;
+		}
+	}
+
+	/*
+	 * only now calculate the secrets to look for, before the test
+	 * itself could leave them in registers which fn saves on its stack.
+	 */
+	memcpy(secrets[SEC], sec, ED25519_KEY_LEN);
+	secret_len[SEC] = ED25519_KEY_LEN;
+
+	sha512_init(&hash);
+	sha512_add(&hash, sec, ED25519_KEY_LEN);
+	sha512_final(&hash, secrets[HASH]);
+	secret_len[HASH] = 64;
+
+	sha512_init(&hash);
+	sha512_add(&hash, secrets[HASH] + 32, 32);
+	sha512_add(&hash, msg, sizeof(msg));
+	sha512_final(&hash, secrets[NONCE]);
+	secret_len[NONCE] = 64;
+
+	/* the secret scalar a of ed25519 */
+	memcpy(tmp, secrets[HASH], 32);
+	clamp(tmp);
+	sc_import(x, tmp, 32);
+	set_scalar(A, x);
+
+	/* the nonce r */
+	sc_import(x, secrets[NONCE], 64);
+	set_scalar(R, x);
+
+	/* the scalar of x25519_base and the one of ed_scale_mg */
+	memcpy(tmp, sec, 32);
+	clamp(tmp);
+	sc_import(x, tmp, 32);
+	set_scalar(X, x);
+
+	for (j = 0; j < 31; j++)
+		tmp[j] = (tmp[j] >> 3) | (tmp[j+1] << 5);
+	tmp[31] >>= 3;
+	sc_import(x, tmp, 32);
+	set_scalar(K, x);
+
+	for (i = 0; i < NCALLS; i++) {
+		for (k = 0; k < NSECRETS; k++) {
+			pos = find(stacks[i], secrets[k], secret_len[k]);
+			if (pos >= 0) {
+				fprintf(stderr, "scrub-selftest: %s leaves %s at %ld bytes from the top\n",
+					calls[i].name, secret_name[k], STACK_SIZE - pos);
+				failed = 1;
+			}
+		}
+
+		free(stacks[i]);
+	}
+
+	return failed;
+}
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <eddsa.h>
@@ -20,6 +21,74 @@ const int table_num = sizeof(table) / sizeof(table[0]);
 
 
 
+/*
+ * test_multi - compares sha512_multi against sha512_add/sha512_final for
+ * n messages of pseudo-random length, with and without data already
+ * added to the contexts.
+ */
+static int
+test_multi(int n, int prefixed)
+{
+	static uint8_t buf[17][1024];
+	struct sha512 h[17];
+	const struct sha512 *ctx[17];
+	const uint8_t *data[17];
+	size_t len[17], pre;
+	uint8_t out[17][SHA512_HASH_LENGTH];
+	uint8_t checkhash[SHA512_HASH_LENGTH];
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < 1024; j++)
+			buf[i][j] = (uint8_t)rand();
+
+		pre = prefixed ? (size_t)(rand() % 300) : 0;
+		len[i] = rand() % (1024 - 300);
+		data[i] = buf[i] + pre;
+
+		sha512_init(&h[i]);
+		sha512_add(&h[i], buf[i], pre);
+		ctx[i] = &h[i];
+	}
+
+	sha512_multi(n, &out[0][0], prefixed ? ctx : NULL, data, len);
+
+	for (i = 0; i < n; i++) {
+		sha512_add(&h[i], data[i], len[i]);
+		sha512_final(&h[i], checkhash);
+
+		if (memcmp(checkhash, out[i], SHA512_HASH_LENGTH) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * test_stream - hashes the i-th table entry in pieces of random length
+ * and compares with the one-shot hash.
+ */
+static int
+test_stream(int i)
+{
+	struct sha512 h;
+	uint8_t checkhash[SHA512_HASH_LENGTH];
+	int pos, n;
+
+	sha512_init(&h);
+	for (pos = 0; pos < table[i].len; pos += n) {
+		n = rand() % 300;
+		if (n > table[i].len - pos)
+			n = table[i].len - pos;
+		sha512_add(&h, table[i].buffer + pos, n);
+	}
+	sha512_final(&h, checkhash);
+
+	return memcmp(checkhash, table[i].hash, SHA512_HASH_LENGTH) != 0;
+}
+
+
 int main()
 {
 	struct sha512 h;
@@ -37,5 +106,21 @@ int main()
 		}
 	}
 
+	srand(0);
+
+	for (i = 0; i < table_num; i++) {
+		if (test_stream(i) != 0) {
+			fprintf(stderr, "sha512-selftest: streaming hash number %d failed\n", i+1);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < 1000; i++) {
+		if (test_multi(1 + i % 17, i & 1) != 0) {
+			fprintf(stderr, "sha512-selftest: sha512_multi failed in run %d\n", i);
+			return 1;
+		}
+	}
+
 	return 0;
 }
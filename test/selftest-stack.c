@@ -0,0 +1,275 @@
+/*
+ * measures the stack usage of the public functions and checks it against
+ * the limits documented in eddsa.h.
+ *
+ * every function runs on a stack of its own (with makecontext), which is
+ * filled with a pattern before. the deepest byte which doesn't hold the
+ * pattern anymore marks the stack usage.
+ *
+ * afterwards every function runs again on a stack of 8K or 16K, like
+ * the one of a fiber, with an inaccessible page below it.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <eddsa.h>
+
+
+#define STACK_SIZE	(256 << 10)
+#define PATTERN		0xa5
+
+#define SMALL		(8 << 10)
+#define LARGE		(16 << 10)
+
+#define N		16
+
+
+static uint8_t sec[ED25519_KEY_LEN], pub[ED25519_KEY_LEN];
+static uint8_t sig[ED25519_SIG_LEN], badsig[ED25519_SIG_LEN], msg[1024];
+static uint8_t keys[N * X25519_KEY_LEN], out[N * X25519_KEY_LEN];
+
+static const uint8_t *sigs[N], *badsigs[N], *pubs[N], *msgs[N];
+static size_t lens[N];
+static bool valid[N];
+
+static struct ed25519_verify_ctx vctx;
+static struct x25519_peer_ctx peer;
+static struct ed25519_hotkey *hotkey;
+static uint64_t hotmem[(1 << 20) / 8];
+static uint64_t scratchmem[(256 << 10) / 8];
+static struct eddsa_scratch scratch = { scratchmem, sizeof(scratchmem) };
+
+
+static void do_nothing(void) { }
+
+static void do_genpub(void) { ed25519_genpub(pub, sec); }
+static void do_sign(void) { ed25519_sign(sig, sec, pub, msg, sizeof(msg)); }
+static void do_verify(void) { ed25519_verify(sig, pub, msg, sizeof(msg)); }
+static void do_verify2(void) { ed25519_verify2(valid, sigs, pubs, msgs, lens); }
+
+static void
+do_verify_step(void)
+{
+	ed25519_verify_start(&vctx, sig, pub, msg, sizeof(msg));
+	while (ed25519_verify_step(&vctx, 10) < 0)
+		;
+}
+
+static void
+do_verify_batch(void)
+{
+	ed25519_verify_batch(N, valid, sigs, pubs, msgs, lens);
+}
+
+/* with a bad signature the chunk is checked one by one */
+static void
+do_verify_batch_bad(void)
+{
+	ed25519_verify_batch(N, valid, badsigs, pubs, msgs, lens);
+}
+
+static void
+do_verify_batch_scratch(void)
+{
+	ed25519_verify_batch_scratch(&scratch, N, valid, sigs, pubs, msgs, lens);
+}
+
+static void
+do_hotkey_init(void)
+{
+	hotkey = ed25519_hotkey_init(hotmem, ed25519_hotkey_size(sizeof(hotmem)),
+				     pub);
+}
+
+static void
+do_verify_hotkey(void)
+{
+	ed25519_verify_hotkey(sig, hotkey, msg, sizeof(msg));
+}
+
+static void do_x25519(void) { x25519(out, sec, keys); }
+static void do_x25519_base(void) { x25519_base(out, sec); }
+static void do_x25519_batch(void) { x25519_batch(N, out, keys, keys); }
+static void do_x25519_base_batch(void) { x25519_base_batch(N, out, keys); }
+static void do_x25519_batch_scratch(void) { x25519_batch_scratch(&scratch, N, out, keys, keys); }
+static void do_x25519_base_batch_scratch(void) { x25519_base_batch_scratch(&scratch, N, out, keys); }
+static void do_peer_init(void) { x25519_peer_init(&peer, keys); }
+static void do_with_peer(void) { x25519_with_peer(out, sec, &peer); }
+static void do_pk_convert(void) { pk_ed25519_to_x25519(out, pub); }
+static void do_pk_convert_batch(void) { pk_ed25519_to_x25519_batch(N, out, keys); }
+static void do_pk_convert_batch_scratch(void) { pk_ed25519_to_x25519_batch_scratch(&scratch, N, out, keys); }
+static void do_sk_convert(void) { sk_ed25519_to_x25519(out, sec); }
+
+
+/* the limits from eddsa.h and the stack each function has to run on */
+static const struct {
+	const char	*name;
+	void		(*fn)(void);
+	size_t		limit;
+	size_t		size;
+} calls[] = {
+	{ "ed25519_genpub",		do_genpub,		3 << 10, SMALL },
+	{ "ed25519_sign",		do_sign,		4 << 10, SMALL },
+	{ "ed25519_verify",		do_verify,		3 << 10, SMALL },
+	{ "ed25519_verify_step",	do_verify_step,		3 << 10, SMALL },
+	{ "ed25519_verify2",		do_verify2,		9 << 10, LARGE },
+	{ "ed25519_verify_batch",	do_verify_batch,	14 << 10, LARGE },
+	{ "ed25519_verify_batch (bad)",	do_verify_batch_bad,	14 << 10, LARGE },
+	{ "ed25519_verify_batch_scratch", do_verify_batch_scratch, 7 << 10, LARGE },
+	{ "ed25519_hotkey_init",	do_hotkey_init,		10 << 10, LARGE },
+	{ "ed25519_verify_hotkey",	do_verify_hotkey,	3 << 10, SMALL },
+	{ "x25519",			do_x25519,		5 << 10, SMALL },
+	{ "x25519_base",		do_x25519_base,		3 << 10, SMALL },
+	{ "x25519_batch",		do_x25519_batch,	12 << 10, LARGE },
+	{ "x25519_batch_scratch",	do_x25519_batch_scratch, 9 << 10, LARGE },
+	{ "x25519_base_batch",		do_x25519_base_batch,	7 << 10, LARGE },
+	{ "x25519_base_batch_scratch",	do_x25519_base_batch_scratch, 3 << 10, SMALL },
+	{ "x25519_peer_init",		do_peer_init,		5 << 10, SMALL },
+	{ "x25519_with_peer",		do_with_peer,		5 << 10, SMALL },
+	{ "pk_ed25519_to_x25519",	do_pk_convert,		3 << 10, SMALL },
+	{ "pk_ed25519_to_x25519_batch",	do_pk_convert_batch,	7 << 10, LARGE },
+	{ "pk_ed25519_to_x25519_batch_scratch", do_pk_convert_batch_scratch, 3 << 10, SMALL },
+	{ "sk_ed25519_to_x25519",	do_sk_convert,		3 << 10, SMALL },
+};
+
+
+static uint8_t *stack;
+static ucontext_t main_ctx, call_ctx;
+
+
+/*
+ * measure - runs fn on a fresh stack, returns the number of bytes used
+ */
+static size_t
+measure(void (*fn)(void))
+{
+	size_t i;
+
+	memset(stack, PATTERN, STACK_SIZE);
+
+	getcontext(&call_ctx);
+	call_ctx.uc_stack.ss_sp = stack;
+	call_ctx.uc_stack.ss_size = STACK_SIZE;
+	call_ctx.uc_link = &main_ctx;
+	makecontext(&call_ctx, fn, 0);
+
+	if (swapcontext(&main_ctx, &call_ctx) != 0)
+		return STACK_SIZE;
+
+	/* the stack grows down */
+	for (i = 0; i < STACK_SIZE && stack[i] == PATTERN; i++)
+		;
+
+	return STACK_SIZE - i;
+}
+
+
+/*
+ * run_on - runs fn on a stack of size bytes with an inaccessible page
+ * below, so it crashes if fn needs more.
+ *
+ * returns 0 on success and 1 if the stack can't be set up.
+ */
+static int
+run_on(void (*fn)(void), size_t size)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	void *mem;
+	int res;
+
+	if (posix_memalign(&mem, page, page + size) != 0)
+		return 1;
+
+	if (mprotect(mem, page, PROT_NONE) != 0) {
+		free(mem);
+		return 1;
+	}
+
+	getcontext(&call_ctx);
+	call_ctx.uc_stack.ss_sp = (uint8_t *)mem + page;
+	call_ctx.uc_stack.ss_size = size;
+	call_ctx.uc_link = &main_ctx;
+	makecontext(&call_ctx, fn, 0);
+
+	res = (swapcontext(&main_ctx, &call_ctx) != 0);
+
+	mprotect(mem, page, PROT_READ | PROT_WRITE);
+	free(mem);
+
+	return res;
+}
+
+
+int
+main()
+{
+	size_t base, used;
+	unsigned int i;
+	int j;
+
+	srand(0);
+
+	/* use pseudo-random for test keys (DO NOT DO THIS FOR REAL!) */
+	for (j = 0; j < ED25519_KEY_LEN; j++)
+		sec[j] = (uint8_t)rand();
+	for (j = 0; j < (int)sizeof(msg); j++)
+		msg[j] = (uint8_t)rand();
+
+	ed25519_genpub(pub, sec);
+	ed25519_sign(sig, sec, pub, msg, sizeof(msg));
+
+	memcpy(badsig, sig, sizeof(sig));
+	badsig[32] ^= 1;
+
+	for (j = 0; j < N; j++) {
+		sigs[j] = sig;
+		badsigs[j] = (j == 5) ? badsig : sig;
+		pubs[j] = pub;
+		msgs[j] = msg;
+		lens[j] = sizeof(msg);
+		memcpy(keys + j * X25519_KEY_LEN, pub, X25519_KEY_LEN);
+	}
+
+	stack = malloc(STACK_SIZE);
+	if (stack == NULL)
+		return 1;
+
+	/* the usage of makecontext itself */
+	base = measure(do_nothing);
+
+	for (i = 0; i < sizeof(calls) / sizeof(calls[0]); i++) {
+		/* a first call resolves the symbols of the shared library */
+		calls[i].fn();
+
+		used = measure(calls[i].fn) - base;
+		printf("%-36s %6lu bytes\n", calls[i].name, (unsigned long)used);
+
+		if (used > calls[i].limit) {
+			fprintf(stderr, "stack-selftest: %s uses %lu bytes, more than %lu\n",
+				calls[i].name, (unsigned long)used,
+				(unsigned long)calls[i].limit);
+			return 1;
+		}
+	}
+
+	/* a crash here means the function doesn't fit its stack */
+	for (i = 0; i < sizeof(calls) / sizeof(calls[0]); i++) {
+		if (run_on(calls[i].fn, calls[i].size) != 0) {
+			fprintf(stderr, "stack-selftest: no stack of %luK for %s\n",
+				(unsigned long)(calls[i].size >> 10), calls[i].name);
+			return 1;
+		}
+	}
+
+	free(stack);
+
+	return 0;
+}
@@ -15,9 +15,62 @@ struct {
 const int table_num = sizeof(table) / sizeof(table[0]);
 
 
+/*
+ * test_batch - runs x25519_batch with n entries of the table starting
+ * at start, where point number zero is replaced by zero. the same is
+ * done with x25519_batch_scratch in chunks of about a third.
+ */
+static int
+test_batch(int start, int n, int zero)
+{
+	uint8_t scalars[64][X25519_KEY_LEN];
+	uint8_t points[64][X25519_KEY_LEN];
+	uint8_t results[64][X25519_KEY_LEN];
+	uint8_t check[64][X25519_KEY_LEN];
+	uint64_t mem[64 * 40];
+	struct eddsa_scratch scratch = { mem, 0 };
+	int i;
+
+	for (i = 0; i < n; i++) {
+		memcpy(scalars[i], table[start+i].scalar, X25519_KEY_LEN);
+		memcpy(points[i], table[start+i].point, X25519_KEY_LEN);
+		memcpy(results[i], table[start+i].result, X25519_KEY_LEN);
+	}
+
+	if (zero >= 0) {
+		memset(points[zero], 0, X25519_KEY_LEN);
+		memset(results[zero], 0, X25519_KEY_LEN);
+	}
+
+	x25519_batch(n, &check[0][0], &scalars[0][0], &points[0][0]);
+
+	for (i = 0; i < n; i++) {
+		if (memcmp(check[i], results[i], X25519_KEY_LEN) != 0)
+			return 1;
+	}
+
+	scratch.size = x25519_batch_scratch_size(1 + n / 3);
+	if (scratch.size > sizeof(mem))
+		return 1;
+
+	memset(check, 0, sizeof(check));
+	if (!x25519_batch_scratch(&scratch, n, &check[0][0], &scalars[0][0],
+				  &points[0][0]))
+		return 1;
+
+	for (i = 0; i < n; i++) {
+		if (memcmp(check[i], results[i], X25519_KEY_LEN) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
 int
 main()
 {
+	static struct x25519_peer_ctx peer;
 	uint8_t check[X25519_KEY_LEN];
 	int i;
 
@@ -33,6 +86,31 @@ main()
 	}
 
 
+	/*
+	 * test precomputed peers
+	 */
+	for (i = 0; i < table_num; i++) {
+		x25519_peer_init(&peer, table[i].point);
+		x25519_with_peer(check, table[i].scalar, &peer);
+		if (memcmp(check, table[i].result, X25519_KEY_LEN) != 0) {
+			fprintf(stderr, "dh-selftest: peer test number %d failed\n", i+1);
+			return 1;
+		}
+	}
+
+
+	/*
+	 * test batch interface with different sizes
+	 */
+	for (i = 0; i + 64 <= table_num; i += 64) {
+		if (test_batch(i, 64, -1) || test_batch(i, 13, -1)
+		    || test_batch(i, 1 + i % 37, i % (1 + i % 37))) {
+			fprintf(stderr, "dh-selftest: batch test at %d failed\n", i+1);
+			return 1;
+		}
+	}
+
+
 	/*
 	 * test old interface
 	 */
@@ -17,7 +17,12 @@ int main()
 	uint8_t result[X25519_KEY_LEN];
 	uint8_t check[X25519_KEY_LEN];
 
-	unsigned int i, j;
+	static uint8_t xs[TESTNUM][X25519_KEY_LEN], results[TESTNUM][X25519_KEY_LEN];
+	static uint8_t batch[TESTNUM][X25519_KEY_LEN];
+	uint64_t mem[1024];
+	struct eddsa_scratch scratch = { mem, 0 };
+
+	unsigned int i, j, n;
 
 	srand(0);
 
@@ -39,6 +44,48 @@ int main()
 			fprintf(stderr, "x25519-base-selftest: x25519_base differs from x25519!\n");
 			return 1;
 		}
+
+		memcpy(xs[i], x, X25519_KEY_LEN);
+		memcpy(results[i], result, X25519_KEY_LEN);
+	}
+
+	/*
+	 * the batch on the stack, for sizes around and between its chunks,
+	 * into separate output and in place.
+	 */
+	for (n = 0; n <= TESTNUM; n += 1 + n / 2) {
+		memset(batch, 0, sizeof(batch));
+		x25519_base_batch(n, &batch[0][0], &xs[0][0]);
+		if (memcmp(batch, results, n * X25519_KEY_LEN) != 0) {
+			fprintf(stderr, "x25519-base-selftest: x25519_base_batch differs from x25519_base for %u scalars!\n", n);
+			return 1;
+		}
+
+		memcpy(batch, xs, n * X25519_KEY_LEN);
+		x25519_base_batch(n, &batch[0][0], &batch[0][0]);
+		if (memcmp(batch, results, n * X25519_KEY_LEN) != 0) {
+			fprintf(stderr, "x25519-base-selftest: x25519_base_batch in place differs from x25519_base for %u scalars!\n", n);
+			return 1;
+		}
+	}
+
+	x25519_base_batch(TESTNUM, &batch[0][0], &xs[0][0]);
+	if (memcmp(batch, results, sizeof(results)) != 0) {
+		fprintf(stderr, "x25519-base-selftest: x25519_base_batch differs from x25519_base!\n");
+		return 1;
+	}
+
+	/* the batch in scratch memory, in chunks of 13 scalars */
+	scratch.size = x25519_base_batch_scratch_size(13);
+	if (scratch.size > sizeof(mem) ||
+	    !x25519_base_batch_scratch(&scratch, TESTNUM, &xs[0][0], &xs[0][0])) {
+		fprintf(stderr, "x25519-base-selftest: batch in scratch memory failed!\n");
+		return 1;
+	}
+
+	if (memcmp(xs, results, sizeof(results)) != 0) {
+		fprintf(stderr, "x25519-base-selftest: x25519_base_batch_scratch differs from x25519_base!\n");
+		return 1;
 	}
 
 	return 0;